@@ -35,15 +35,24 @@
  * Set your SDR software to monitor from 60 to 62 Mhz.
  *
  * This will set 60.0 Mhz in clock 0, put and alternating frequencies
- * at 60.5 and 61.0 Mhz on CLK1 and CLK2 to show they are mutually exclusive.
+ * at 60.5 and 61.0 Mhz on CLK1 and CLK2 to show all three can run at once
+ * (CLK2 shares a PLL, the lib's PLL allocator handles that)
  *
  * Then make a sweep from 60 to 62 Mhz on CLK2, with an stop every 200Khz
  * and then a train of one second pulses will follow with varying power levels
  *
+ * At the end of each sweep the count of PLL resets (click noise events) is
+ * printed on the serial port (115200 bps), per MHz; it comes from the lib
+ * counters, see SI_STATS below.
+ *
  * Take into account your XTAL error, see Si.correction(###) below
  *
  ***************************************************************************/
 
+// the lib hot path counters for the resets count, the lib must be built
+// with it too: uncomment it here and pass -DSI_STATS as a build flag
+//#define SI_STATS
+
 #include "si5351mcu.h"
 
 // lib instantiation as "Si"
@@ -58,9 +67,13 @@ long freqStart =   60000000;  //  60.0 MHz
 long freqStop  =   62000000;  //  62.0 MHz
 long step      =      10000;  //  10.0 kHz
 long freq      = freqStart;
+uint32_t sweepResets = 0;     // PLL resets at the start of the sweep
 
 
 void setup() {
+    // serial port to show the resets count
+    Serial.begin(115200);
+
     // init the Si5351 lib
     Si.init();
 
@@ -68,6 +81,8 @@ void setup() {
     // just pass it on the init procedure, just like this
     // Si.init(26570000);
 
+    // or Si.initWarm() to keep the outputs running if only the MCU rebooted
+
     // set & apply my calculated correction factor
     Si.correction(-1250);
 
@@ -82,32 +97,29 @@ void setup() {
     Si.setFreq(0, freqStart);
     Si.enable(0);
 
-    // make the dance on the two outputs
+    // make the dance on the other two outputs, one after the other
     Si.setFreq(1, freqStart +  500000);      // CLK1 output
     Si.enable(1);
     delay(3000);
-    // Si.disable(1);   // no need to disable, enabling CLK2 disable this
 
+    // now the three of them at once; setFreq() returns false if the freq
+    // can't be made with the other outputs running, not the case here
     Si.setFreq(2, freqStart + 1000000);      // CLK2 output
     Si.enable(2);
-    delay(3000);
-    //Si.disable(2);   // no need to disable, enabling CLK1 disable this
+    delay(6000);
 
-    Si.setFreq(1, freqStart +  500000);      // CLK1 output
-    Si.enable(1);
-    delay(3000);
-    //Si.disable(1);   // no need to disable, enabling CLK2 disable this
-
-    Si.setFreq(2, freqStart + 1000000);      // CLK2 output
-    Si.enable(2);
-    delay(3000);
-    Si.disable(2);   // this is the last in the dance, disable it
+    // this is the last in the dance, disable them
+    Si.disable(1);
+    Si.disable(2);
 
     // shut down CLK0
     Si.disable(0);
 
     // set CLK2 to the start freq
     Si.setFreq(2, freqStart);   // it's disabled by now
+#ifdef SI_STATS
+    sweepResets = Si.getStats().resets;
+#endif
 }
 
 
@@ -145,14 +157,33 @@ void loop() {
             // no, set and increment
             Si.setFreq(2,freq);        // but it can be with CLK0 or CLK1 instead
 
+            // wait for the PLL to lock, it's at once unless the output
+            // divider changed and the PLL was reset; no worst case delays
+            Si.waitLocked(10000);
+
             // set it for the new cycle
             freq += step;
 
             // a short delay to slow things a little.
             delay(50);
         } else {
-            // we reached the limit, reset to start
+            // we reached the limit, show the resets in the sweep
+            Serial.print(F("Sweep done"));
+#ifdef SI_STATS
+            Serial.print(F(", PLL resets: "));
+            Serial.print(Si.getStats().resets - sweepResets);
+            Serial.print(F(" ("));
+            Serial.print((float)(Si.getStats().resets - sweepResets) * 1000000.0 / (freqStop - freqStart));
+            Serial.print(F(" per MHz)"));
+#endif
+            Serial.println();
+
+            // reset to start
             freq = freqStart;
+            Si.setFreq(2, freq);
+#ifdef SI_STATS
+            sweepResets = Si.getStats().resets;
+#endif
         }
     }
 }
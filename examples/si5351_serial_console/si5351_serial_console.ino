@@ -42,9 +42,17 @@
 /***************************************************************************
  * Type HELP into the Arduino Serial Console line for a list of commands.
  *
+ * A PC or SDR program can drive it at a high rate with the binary frames
+ * too, see "Binary mode" below; both can be mixed at any time.
+ *
  * Take into account your XTAL error, see Si.correction(###) below
  ***************************************************************************/
 
+// the lib hot path counters for the STATS command, the lib must be built
+// with it too: uncomment it here and pass -DSI_STATS as a build flag (or
+// -DSI_STATS_TIME to get the time on the bus as well)
+//#define SI_STATS
+
 #include "si5351mcu.h"
 
 // lib instantiation as "Si"
@@ -52,7 +60,6 @@ Si5351mcu Si;
 
 int   cmdHelp( void );
 void  resetInput( void );
-float getPllFraction( uint8_t pllIndex );
 void  printDecimalByte( int val );
 
 uint8_t devicePresent = 0;
@@ -77,6 +84,10 @@ void setup() {
     // reset the PLLs
     Si.reset();
     Si.off();
+
+    // the writes go out from the loop (see pump() there), the binary frames
+    // are taken while the last ones are still on the bus
+    Si.setAsync(true);
         
     Serial.begin(115200);
     while (!Serial);    // Wait for devices such as Leonardo to start Serial
@@ -93,6 +104,9 @@ void setup() {
     Serial.println(F("**********************************************************"));
     Serial.println(F(""));
 
+    // is there anything answering on the bus?
+    devicePresent = Si.i2cRead( 0 ) >= 0;
+
     if ( devicePresent ) {
       cmdHelp();
     }
@@ -128,222 +142,86 @@ void printWarning( char *str ) {
   Serial.println( str );
 }
 
-int8_t displayClockSource( uint8_t clkIndex ) {
-  int16_t   val;
-  uint32_t  uval;
-  int8_t    result = -1;
-  uint8_t   intdiv = 1;
-  bool      blnIntDiv = false;
-  bool      blnIntDiv4 = false;
-  float     pllMult = 1;
-  float     pllFreq = 1;
-  float     msynDiv = 1;
-  float     active = 1;
-  
-  do { // while(0) - Artificial construct to allow break;
-    
-    uval = val = Si.i2cRead( 16 + clkIndex );
-    if ( val < 0 ) {
-      break;
-    }
-    Serial.print( clkIndex, DEC );
-    Serial.print( F(": PD=") );
-    Serial.print( (uval & 0x80) >> 7, DEC );    // Power down state
-    active = !((uval & 0x80) >> 7);
-
-    val = Si.i2cRead( 44 + clkIndex * 8 );
-    if ( val >= 0 ) {
-      switch ( ( val & 0x0c ) >> 2 ) {
-        case 3:
-          blnIntDiv4 = true;
-          // drop through is intentional - no break;     
-        case 0:
-          intdiv = (val & 0x70) >> 4;
-          intdiv = 1 << intdiv;
-          blnIntDiv = true;
-          break;
-        default:
-          intdiv = 0;   // Unknown state
-          break;
-      }
-    }    
-    Serial.print( F(", R=" ) );
-    Serial.print( intdiv , DEC );    
-    
-    Serial.print( F(", Div=") );
-    if ( uval & 0x40 || clkIndex >= 6 ) {
-        Serial.print(F("Int, PLL="));
-    }
-    else {
-      Serial.print( F("Frac, PLL=") );
-    }
-    // PLL
-    Serial.print( (char) ('A' + (( uval & 0x20 ) >> 5) ));  // PLL 'A' or 'B'
-    Serial.print( F(", INV=" ) );
-
-    pllMult = getPllFraction( ( uval & 0x20 ) >> 5 );
-    pllFreq = pllMult * Si.getXtalCurrent();
-    
-    Serial.print( (( uval & 0x10 ) >> 4), DEC );
-    Serial.print( F(", Src=" ) );
-    switch( ( uval & 0x0C ) >> 2 ) {
-    case 0:
-        Serial.print( F("XTAL, ") );
-        active = 0;
-        break;  
-    case 1:
-        Serial.print( F("CLKIN, ") );
-        active = 0;
-        break;  
-    case 2:
-        if ( clkIndex == 0 ) {
-          Serial.print( F("MSYN0/Undefined:") );
-        }
-        else {
-          Serial.print( F("MSYN0/R:") );
-        }
-        Serial.print( msynDiv = getMsynthFraction( 0 ));
-        Serial.print( F(", ") );
-        break;  
-    case 3:
-    default:
-        Serial.print( F("MSYN" ) );
-        Serial.print( clkIndex, DEC );
-        Serial.print( F(":") );
-        Serial.print( msynDiv = getMsynthFraction( clkIndex ));
-        Serial.print( F(", ") );
-        break;  
-    }
-    Serial.print( F("Pwr=") );
-    Serial.print( uval & 0x03, DEC );
-    Serial.print( F(", Frequency=") );
-    if ( blnIntDiv4 ) {
-      // Special divide by 4
-      // msynDiv = 1.0;          
-    }
+//
+// Print a milli Hz value as Hz with 3 decimals, integer math only
+//
+void printMilli( uint64_t val ) {
+  char buf[6] = { 0 };
 
-    Serial.print( active * pllFreq / ( msynDiv * intdiv ));
-    Serial.println(F(""));
-     
-  } while ( 0 );
-  
-  
-  return result;
+  Serial.print( (uint32_t)(val / 1000), DEC );
+  sprintf( buf, ".%03u", (uint16_t)(val % 1000) );
+  Serial.print( buf );
 }
 
 //
-// CAUTION - USE OF DOUBLE OR FLOAT GREATLY INCREASES BUILD SIZE
-// This is for diagnostic purposes only.
+// Print a PLL multiplier or multisynth divider with 6 decimals
 //
-// 'float' does not have sufficient precision for values to be accurate
-//
-
-// The same register offsets work for both the PLL fractions
-// and the multi-synth dividers (in integer mode)
-// 
-
-float getFractionalRatio( uint8_t register_base ) {
-  uint32_t MSNx_P1;   // 18 bit
-  uint32_t MSNx_P2;   // 20 bit
-  uint32_t MSNx_P3;   // 20 bit
-  int16_t  val;
-  uint32_t uval;
-  uint8_t  reg = register_base;
-  float    result = -1.0;   // returns -1.0 on error
-  float    abc;
-  
-  do { // while(0) - Artificial construct to allow break;
-    
-    uval = val = Si.i2cRead( reg++ );   // + 0
-    if ( val < 0 ) {
-      break;
-    }
-    MSNx_P3 = uval << 8;
-    
-    uval = val = Si.i2cRead( reg++ );   // + 1
-    if ( val < 0 ) {
-      break;
-    }
-    MSNx_P3 |= (uval & 0xFF);
+void printRatio( const Si5351div &d ) {
+  char buf[10] = { 0 };
+  uint64_t val = Si5351mcu::ratio( d, 1000000 );
 
-    uval = val = Si.i2cRead( reg++ );   // + 2
-    if ( val < 0 ) {
-      break;
-    }
-    MSNx_P1 = ( uval & 0x03) << 16;
-
-    uval = val = Si.i2cRead( reg++ );   // + 3
-    if ( val < 0 ) {
-      break;
-    }
-    MSNx_P1 |= ((uval & 0xFF) << 8);
-    
-    uval = val = Si.i2cRead( reg++ );   // + 4
-    if ( val < 0 ) {
-      break;
-    }
-    MSNx_P1 |= (uval & 0xFF);
+  Serial.print( (uint32_t)(val / 1000000), DEC );
+  sprintf( buf, ".%06lu", (unsigned long)(val % 1000000) );
+  Serial.print( buf );
+}
 
-    uval = val = Si.i2cRead( reg++ );   // + 5
-    if ( val < 0 ) {
+//
+// Show an output from the decoded chip state (see cmdShow)
+//
+void displayClockSource( uint8_t clkIndex, const Si5351state &st ) {
+  const Si5351clk &c = st.clk[ clkIndex ];
+
+  Serial.print( clkIndex, DEC );
+  Serial.print( F(": PD=") );
+  Serial.print( (c.ctrl & 0x80) >> 7, DEC );    // Power down state
+  Serial.print( F(", OEB=") );
+  Serial.print( (st.oeb >> clkIndex) & 1, DEC );
+  Serial.print( F(", R=" ) );
+  Serial.print( c.R, DEC );
+
+  Serial.print( F(", Div=") );
+  if ( c.ctrl & 0x40 || clkIndex >= 6 ) {
+      Serial.print(F("Int, PLL="));
+  }
+  else {
+    Serial.print( F("Frac, PLL=") );
+  }
+  // PLL
+  Serial.print( (char) ('A' + (( c.ctrl & 0x20 ) >> 5) ));  // PLL 'A' or 'B'
+  Serial.print( F(", INV=" ) );
+  Serial.print( (( c.ctrl & 0x10 ) >> 4), DEC );
+  Serial.print( F(", Src=" ) );
+  switch( ( c.ctrl & 0x0C ) >> 2 ) {
+  case 0:
+      Serial.print( F("XTAL, ") );
       break;
-    }
-    MSNx_P3 |= ((uval & 0xF0) << 12);
-    MSNx_P2 = ((uval & 0x0F) << 16);
-
-    uval = val = Si.i2cRead( reg++ );   // + 6
-    if ( val < 0 ) {
+  case 1:
+      Serial.print( F("CLKIN, ") );
       break;
-    }
-    MSNx_P2 |= ((uval & 0xFF) << 8);
-    
-    uval = val = Si.i2cRead( reg++ );   // + 7
-    if ( val < 0 ) {
+  case 2:
+      if ( clkIndex == 0 ) {
+        Serial.print( F("MSYN0/Undefined, ") );
+      }
+      else {
+        Serial.print( F("MSYN0/R, ") );
+      }
       break;
-    }
-    MSNx_P2 |= (uval & 0xFF);
-
-    // Re-arranging equations to solve ( a + b/c )
-    //    (a + b/c) = ( P1 + P2/c + 512.0 ) / 128.0
-
-    if ( MSNx_P3 == 0 ) {
-      // divide by zero error - c == 0
+  case 3:
+  default:
+      Serial.print( F("MSYN" ) );
+      Serial.print( clkIndex, DEC );
+      Serial.print( F(":") );
+      printRatio( c.ms );
+      Serial.print( F(", ") );
       break;
-    }
-    
-    else // above is the last if() that can fail/break, calculate result.
-    {
-      abc = ( MSNx_P1 + ( (float) MSNx_P2 ) / MSNx_P3 + 512 ) / 128.0;
-  
-      result = abc;
-    }
-    
-  } while(0);
-  
-  return result;
-}
-
-// PLL Fractions are Multipliers of the clock frequency
-float getPllFraction( uint8_t pllIndex ) {
-  // this is a test harness - no validation
-
-  return getFractionalRatio( 26 + 8 * pllIndex );
-}
-
-// Multisynth fractions are Dividers of the providing PLL
-float getMsynthFraction( uint8_t msIndex ) {
-  // this is a test harness - no validation
-
-  float result;
-  if ( msIndex < 6 ) {
-    result = getFractionalRatio( 42 + 8 * msIndex );
-  }
-  else {
-    // different equations for integer only MSYTH 6 and 7 
-    // registers 90/92 and 91/93
-    result = -1.0;    // not implemented yet
   }
-  return result;
+  Serial.print( F("Pwr=") );
+  Serial.print( c.ctrl & 0x03, DEC );
+
+  // only the MSx sourced outputs are decoded, 0 if off
+  Serial.print( F(", Frequency=") );
+  printMilli( c.freq );
+  Serial.println(F(""));
 }
 
 //
@@ -375,16 +253,18 @@ void printDecimalByte( int16_t val ) {
 //
 // Displays a hexadecimal data dump of a byte range of registers
 //
+// a burst read per row: a short read shows the missing bytes as "??"
+//
 int cmdSubsetDump( int start, int count, int stride ) {
-  int j, k;
-  int val;
-  
+  int j, k, n;
+  uint8_t row[16];
+
   for ( j = start; j < (start + stride * count); j+= stride ) {
     printByte( j );
     Serial.print(": ");
+    n = Si.i2cReadBurst( j, row, stride );
     for ( k = 0; k < stride; k++ ) {
-      val = Si.i2cRead( j + k );
-      printByte( val );
+      printByte( k < n ? row[k] : -1 );
       Serial.print(" ");
     }
     Serial.println(F(""));
@@ -410,20 +290,31 @@ int cmdPllDump( void ) {
 // Show in HEX, the registers for a MSYNTH divider
 //
 int cmdSynthDump( void ) {
-  return cmdSubsetDump( 42, SICHANNELS, 8 );
+  return cmdSubsetDump( 42, Si.getChannels(), 8 );
 }
 
 //
-// Show general characteristics from the register state;
-// floats will be inaccurate and are for guidance only
+// Show general characteristics from the register state, all read in a
+// few bursts and decoded by the lib with integer math (exact to the mHz)
 //
 int cmdShow( void ) {
   int j;
-  float frq;
-  
+  Si5351state st;
+
+  if ( !Si.readState( st ) ) {
+    printError("Can't read the device.");
+    return -1;
+  }
+
   Serial.print("Selected Command Channel Output: ");
   Serial.println( output_chan, DEC );
   Serial.println(F(""));
+  Serial.print(F("Status: "));
+  printByte( st.status );
+  Serial.print(F("  Sticky: "));
+  printByte( st.sticky );
+  Serial.println(F(""));
+  Serial.println(F(""));
   Serial.println(F("XTAL:"));
   Serial.print(F("  Base:    "));
   Serial.println( Si.getXtalBase(), DEC );
@@ -431,22 +322,74 @@ int cmdShow( void ) {
   Serial.println( Si.getXtalCurrent(), DEC );
   Serial.println(F(""));
   Serial.println(F("PLL ratios:"));
-  Serial.print(F("  A "));
-  Serial.print( frq = getPllFraction( 0 ));
-  Serial.print(F("  "));
-  Serial.println( frq * Si.getXtalCurrent() );
-  Serial.print(F("  B "));
-  Serial.print( frq = getPllFraction( 1 ));
-  Serial.print(F("  "));
-  Serial.println( frq * Si.getXtalCurrent() );
+  for ( j = 0; j < 2; j++ ) {
+    Serial.print( j ? F("  B ") : F("  A ") );
+    printRatio( st.pll[j] );
+    Serial.print(F("  "));
+    printMilli( st.vco[j] );
+    Serial.println(F(" Hz"));
+  }
   Serial.println(F(""));
 
-  for( j = 0; j < SICHANNELS; j++ ) {
-    displayClockSource( j );
+  for( j = 0; j < Si.getChannels(); j++ ) {
+    displayClockSource( j, st );
   }
   return 0;
 }
 
+//
+// Show the lib counters (SI_STATS), to profile a live radio
+//
+int cmdStats( void ) {
+#ifdef SI_STATS
+  const Si5351stats &st = Si.getStats();
+
+  Serial.print(F("setFreq:  "));
+  Serial.print( st.calls, DEC );
+  Serial.print(F(" (fast "));
+  Serial.print( st.fast, DEC );
+  Serial.print(F(", full "));
+  Serial.print( st.full, DEC );
+  Serial.println(F(")"));
+  Serial.print(F("Resets:   "));
+  Serial.println( st.resets, DEC );
+  Serial.print(F("I2C:      "));
+  Serial.print( st.writes, DEC );
+  Serial.print(F(" writes, "));
+  Serial.print( st.reads, DEC );
+  Serial.println(F(" reads"));
+  Serial.print(F("Bytes:    "));
+  Serial.print( st.bytesWritten, DEC );
+  Serial.print(F(" out, "));
+  Serial.print( st.bytesRead, DEC );
+  Serial.println(F(" in"));
+  Serial.print(F("Errors:   "));
+  Serial.print( st.errors, DEC );
+  Serial.print(F(", "));
+  Serial.print( st.retries, DEC );
+  Serial.println(F(" retries"));
+#ifdef SI_STATS_TIME
+  Serial.print(F("Bus time: "));
+  Serial.print( st.busMicros, DEC );
+  Serial.println(F(" us"));
+#endif
+  return 0;
+#else
+  printError("Not built with SI_STATS.");
+  return -1;
+#endif
+}
+
+int cmdStatsReset( void ) {
+#ifdef SI_STATS
+  Si.resetStats();
+  return 0;
+#else
+  printError("Not built with SI_STATS.");
+  return -1;
+#endif
+}
+
 /*
 int cmdCal() {
   // Does not seem to work
@@ -459,7 +402,7 @@ int cmdCal() {
 */
 
 int cmdClkChanSet( int32_t chan ) {
-  if ( chan < SICHANNELS && chan >= 0 ) {
+  if ( chan < Si.getChannels() && chan >= 0 ) {
     output_chan = chan;
   }
   else {
@@ -573,8 +516,11 @@ int cmdHelp( void ) {
   Serial.println(F("  RESET        - PLL Reset Si5351."));
   Serial.println(F("  SET <R> <N>  - Set Si5351 register 'R' to 'N' (decimal)."));
   Serial.println(F("  SHOW         - Show present parameters."));
+  Serial.println(F("  STATS        - Show the lib counters (if built with SI_STATS)."));
+  Serial.println(F("  STATS RESET  - Clear the lib counters."));
   Serial.println(F("  MSYNDUMP     - Display Si5351 MSynth registers."));
   Serial.println(F("  XTAL <N> <E> - Set XTAL Clock Frequency, to <N> Hz, with error offset <E> Hz."));
+  Serial.println(F("  (binary frames are also taken, see the source)"));
   
   return 0;
 }
@@ -623,6 +569,9 @@ int cmdProcess( int nargs ) {
         else if ( !strcmp( "MSYNDUMP", args[0] ) ) {
           done = cmdSynthDump();
         }
+        else if ( !strcmp( "STATS", args[0] ) ) {
+          done = cmdStats();
+        }
         break;
         
       case 2:
@@ -637,6 +586,9 @@ int cmdProcess( int nargs ) {
         else if ( !strcmp( "PWR", args[0] ) ) {
           done = cmdPwrSet( val );
         }
+        else if ( !strcmp( "STATS", args[0] ) && !strcmp( "RESET", args[1] ) ) {
+          done = cmdStatsReset();
+        }
         break;
         
       case 3:
@@ -661,6 +613,7 @@ int cmdProcess( int nargs ) {
     else {
       Serial.println(F("OK"));
     }
+    return done;
 }
 
 //
@@ -670,9 +623,12 @@ void cmdParseAndProcess(void) {
   char *p;
   int j = 0;
   int k;
-  
+
+  // the text commands see (and make) the writes at once
+  Si.setAsync(false);
+
   p = strtok( inputBuffer, " ");
-  while ( *p )
+  while ( p )
   {
     args[j++] = p;
     p = strtok( 0, " ");
@@ -681,13 +637,163 @@ void cmdParseAndProcess(void) {
   {
     p = args[k];
     while ( *p ) {
-      *p++ = toupper( *p );
+      *p = toupper( *p );
+      p++;
     }
   }
   if ( j ) {
     cmdProcess( j );
   } 
   resetInput();
+
+  Si.setAsync(true);
+}
+
+//
+// Binary mode: framed commands for a PC or SDR program tuning at a high
+// rate, a frame starts with a byte no text line starts with so they can be
+// mixed with the text commands at any time.
+//
+//   frame: SYNC SEQ CMD LEN DATA[LEN] SUM
+//     SYNC: 0xA5
+//     SEQ:  0..127, a frame counter from the PC, it comes back on the ack
+//     SUM:  the XOR of SEQ, CMD, LEN & DATA
+//
+//   ack: a single byte, SEQ if done or SEQ | 0x80 if not (bad sum, unknown
+//     command, bad arguments, a freq the lib can't make or an output it
+//     can't enable); the 'S' ack is followed by LEN & the reply data.
+//
+//   A frame with a gap of more than BIN_TIMEOUT mS between two bytes (a
+//   byte lost on the line) is dropped with no ack, the next SYNC starts a
+//   new one.
+//
+// Multi byte values are little endian. The commands:
+//   'F' clk, freq(4)             set the freq of an output (Hz)
+//   'M' clk, freq(8)             same in milli Hz (high precision mode)
+//   'L' n x (clk, freq(4))       set a list of outputs at once, a single
+//                                I2C transaction & a reset at most
+//   'P' clk, level               output power (0..3), it enables the output
+//   'E' clk, on                  enable (1) or disable (0) an output
+//   'S'                          status: the reply is status, sticky, the
+//                                enabled outputs (a bit each) & resets(4),
+//                                the PLL resets from the lib counters (0 if
+//                                not built with SI_STATS)
+//
+// The lib is in async mode: the frame is acked as soon as the registers are
+// computed and the loop sends a burst on each pass (Si.pump()), so the next
+// frames are decoded while the earlier writes are on the bus; a retune of
+// an output still waiting is replaced by the newer one (latest wins). Keep
+// a few frames in flight and match the acks, no need to wait for each one.
+//
+#define BIN_SYNC 0xA5
+#define BIN_MAX  64       // a whole frame, a list of up to 11 outputs
+#define BIN_TIMEOUT 20    // mS, max gap between the bytes of a frame
+
+uint8_t binFrame[ BIN_MAX ];
+uint8_t binIndex = 0;     // bytes of the frame so far, 0 if none
+uint32_t binLast;         // millis() of the last byte
+
+uint32_t binLong( const uint8_t *p ) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 |
+         (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+bool binProcess( uint8_t cmd, const uint8_t *data, uint8_t len ) {
+  uint8_t j;
+  bool ok = true;
+  int16_t st, sk;
+  uint32_t resets;
+  uint8_t reply[8];
+
+  // all but the status have the clk first
+  if ( cmd != 'S' && ( len < 2 || data[0] >= Si.getChannels() ) ) return false;
+
+  switch ( cmd ) {
+  case 'F':
+    return len == 5 && Si.setFreq( data[0], binLong( data + 1 ) );
+
+  case 'M':
+    return len == 9 && Si.setFreqMilli( data[0],
+      (uint64_t)binLong( data + 5 ) << 32 | binLong( data + 1 ) );
+
+  case 'L':
+    if ( len % 5 ) return false;
+    for ( j = 0; j < len; j += 5 ) {
+      if ( data[j] >= Si.getChannels() ) return false;
+    }
+    Si.begin();
+    for ( j = 0; j < len; j += 5 ) {
+      ok &= Si.setFreq( data[j], binLong( data + j + 1 ) );
+    }
+    Si.commit();
+    return ok;
+
+  case 'P':
+    return len == 2 && data[1] <= 3 && Si.setPower( data[0], data[1] );
+
+  case 'E':
+    if ( len != 2 ) return false;
+    return data[1] ? Si.enable( data[0] ) : Si.disable( data[0] );
+
+  case 'S':
+    // what the chip does, not what is waiting
+    while ( Si.pump() );
+    st = Si.status();
+    sk = Si.sticky();
+    if ( len || st < 0 || sk < 0 ) return false;
+
+    reply[0] = 7;
+    reply[1] = st;
+    reply[2] = sk;
+    reply[3] = 0;
+    for ( j = 0; j < Si.getChannels(); j++ ) {
+      if ( Si.clkOn[j] ) reply[3] |= 1 << j;
+    }
+#ifdef SI_STATS
+    resets = Si.getStats().resets;
+#else
+    resets = 0;
+#endif
+    for ( j = 0; j < 4; j++ ) {
+      reply[4 + j] = resets >> (8 * j);
+    }
+    Serial.write( binFrame[1] );
+    Serial.write( reply, sizeof(reply) );
+    return true;
+  }
+
+  return false;
+}
+
+//
+// Take a byte of a frame, process it when complete
+//
+void binByte( uint8_t c ) {
+  uint8_t j, sum = 0;
+
+  binLast = millis();
+  binFrame[ binIndex++ ] = c;
+
+  // SYNC SEQ CMD LEN: a frame too big can't be taken, drop it
+  if ( binIndex == 4 && binFrame[3] > BIN_MAX - 5 ) {
+    Serial.write( (binFrame[1] & 0x7F) | 0x80 );
+    binIndex = 0;
+    return;
+  }
+  if ( binIndex < 5 || binIndex < 5 + binFrame[3] ) return;
+  binIndex = 0;
+
+  for ( j = 1; j < 4 + binFrame[3]; j++ ) {
+    sum ^= binFrame[j];
+  }
+
+  if ( binFrame[1] > 0x7F || sum != binFrame[4 + binFrame[3]] ||
+       !binProcess( binFrame[2], binFrame + 4, binFrame[3] ) ) {
+    Serial.write( (binFrame[1] & 0x7F) | 0x80 );
+  }
+  else if ( binFrame[2] != 'S' ) {
+    Serial.write( binFrame[1] );
+  }
 }
 
 void loop() {
@@ -696,10 +802,19 @@ void loop() {
     if ( !devicePresent ) {
       return ;
     }
+
+    // a frame cut short (a lost or corrupt LEN, a lost byte) would take
+    // the next frames as its data: drop it after a gap
+    if ( binIndex && millis() - binLast > BIN_TIMEOUT ) {
+      binIndex = 0;
+    }
     
     while ( Serial.available() > 0 ) {
       c = Serial.read();
-      if ( c == 13 )    
+      if ( binIndex || ( inputIndex == 0 && (uint8_t)c == BIN_SYNC ) ) {
+        binByte( c );
+      }
+      else if ( c == 13 )    
       {
         inputBuffer[ inputIndex ] = '\0';
         Serial.println(inputBuffer);
@@ -714,4 +829,7 @@ void loop() {
         printError("Input overflow.");
       }
     }
+
+    // a burst of the pending writes, if any
+    Si.pump();
 }
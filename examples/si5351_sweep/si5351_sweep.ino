@@ -0,0 +1,98 @@
+/*
+ * si5351mcu - Si5351 library for Arduino, MCU tuned for size and click-less
+ *
+ * Sweep example: the sequencer on a scalar analyzer.
+ *
+ * Copyright (C) 2017 Pavel Milanes <pavelmc@gmail.com>
+ *
+ * Many chunk of codes are derived-from/copied from other libs
+ * all GNU GPL licenced:
+ *  - Linux Kernel (www.kernel.org)
+ *  - Hans Summers libs and demo code (qrp-labs.com)
+ *  - Etherkit (NT7S) Si5351 libs on github
+ *  - DK7IH example.
+ *  - Jerry Gaffke integer routines for the bitx20 group
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/***************************************************************************
+ * A scalar analyzer sweep: CLK0 goes from 1 to 30 MHz in 50 kHz steps with
+ * a fixed dwell of 2 mS per step, a detector on the A0 pin (a diode or a
+ * log amp after the filter or antenna under test) is sampled all the time
+ * and the last sample of each step is printed as "freq,level" on the
+ * serial port (115200 bps), ready to plot.
+ *
+ * The steps are computed ahead by the sequencer while waiting, so each one
+ * is just the I2C bytes that change and the dwell is the same for all of
+ * them, no delay() and no math on the step. The resets (output divider
+ * changes) are known in advance, see the plannedResets() below.
+ *
+ * Take into account your XTAL error, see Si.correction(###) below
+ ***************************************************************************/
+
+#include "si5351mcu.h"
+
+// lib instantiation as "Si"
+Si5351mcu Si;
+
+// the sequencer, with a ring of 64 bytes for the frames (~16 steps ahead)
+uint8_t ring[64];
+Si5351seq seq(Si, ring, sizeof(ring));
+
+#define START     1000000   //  1.0 MHz
+#define STOP     30000000   // 30.0 MHz
+#define STEP        50000   // 50 kHz
+#define DWELL        2000   //  2 mS per step
+
+uint32_t lastFreq = 0;
+int level = 0;
+
+
+void setup() {
+    Serial.begin(115200);
+
+    // init the Si5351 lib
+    Si.init();
+
+    // set & apply my calculated correction factor
+    Si.correction(-1250);
+
+    // the output on, then the sweep: the first step is set at once
+    Si.enable(0);
+    seq.sweep(0, START, STOP, STEP, DWELL, true);
+
+    Serial.print(F("# PLL resets per sweep: "));
+    Serial.println(seq.plannedResets());
+    lastFreq = seq.freq();
+}
+
+
+void loop() {
+    // the detector, the last sample before the step is the one we keep
+    level = analogRead(A0);
+
+    // the next step is made here when it's due
+    if (seq.poll()) {
+        Serial.print(lastFreq);
+        Serial.print(',');
+        Serial.println(level);
+
+        // a reset on this step? the PLL takes some time to lock
+        if (seq.wasReset()) Si.waitLocked(10000);
+
+        lastFreq = seq.freq();
+    }
+}
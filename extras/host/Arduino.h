@@ -0,0 +1,56 @@
+/*
+ * si5351mcu - Si5351 library for Arduino MCU tuned for size and click-less
+ *
+ * Host (Linux) stand-in for the Arduino core, just what the lib and the
+ * host simulator/benchmarks need to build with a plain g++.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define DEC 10
+#define HEX 16
+
+// no flash/ram split on the host
+#define PROGMEM
+#define F(s) (s)
+#define memcpy_P memcpy
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+
+// no interrupts on the host
+#define noInterrupts()
+#define interrupts()
+
+// time keeping, from the host monotonic clock
+uint32_t micros(void);
+uint32_t millis(void);
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+// the Serial port, see HardwareSerial.h
+#include "HardwareSerial.h"
+
+#endif // HOST_ARDUINO_H
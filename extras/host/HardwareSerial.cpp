@@ -0,0 +1,127 @@
+/*
+ * si5351mcu - Si5351 library for Arduino MCU tuned for size and click-less
+ *
+ * Host (Linux) stand-in for the Arduino Serial port.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "HardwareSerial.h"
+
+// the default port, as in the Arduino core
+HardwareSerial Serial;
+
+void HardwareSerial::attach(int fd) {
+    fdIn = fdOut = fd;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    rxLen = rxPos = 0;
+}
+
+int HardwareSerial::available(void) {
+    ssize_t n;
+
+    if (rxPos == rxLen) {
+        rxPos = rxLen = 0;
+        n = ::read(fdIn, rxBuf, sizeof(rxBuf));
+        if (n > 0) rxLen = n;
+    }
+
+    return rxLen - rxPos;
+}
+
+int HardwareSerial::read(void) {
+    if (!available()) return -1;
+
+    bytesIn++;
+    return rxBuf[rxPos++];
+}
+
+size_t HardwareSerial::write(uint8_t val) {
+    return write(&val, 1);
+}
+
+// blocks until all is out, as the Arduino core does when the buffer is full
+size_t HardwareSerial::write(const uint8_t *data, size_t len) {
+    size_t done = 0;
+    ssize_t n;
+
+    while (done < len) {
+        n = ::write(fdOut, data + done, len - done);
+        if (n > 0) {
+            done += n;
+        } else if (n < 0 && errno != EAGAIN && errno != EINTR) {
+            break;
+        }
+    }
+
+    bytesOut += done;
+    return done;
+}
+
+size_t HardwareSerial::printNumber(unsigned long val, int base) {
+    char buf[8 * sizeof(long) + 1];
+    char *p = buf + sizeof(buf);
+
+    if (base < 2) base = 10;
+    do {
+        uint8_t d = val % base;
+        *--p = d < 10 ? '0' + d : 'A' + d - 10;
+        val /= base;
+    } while (val);
+
+    return write((const uint8_t *)p, buf + sizeof(buf) - p);
+}
+
+size_t HardwareSerial::print(const char *str) {
+    return write((const uint8_t *)str, strlen(str));
+}
+
+size_t HardwareSerial::print(char c) {
+    return write((uint8_t)c);
+}
+
+size_t HardwareSerial::print(unsigned char val, int base) {
+    return printNumber(val, base);
+}
+
+size_t HardwareSerial::print(int val, int base) {
+    return print((long)val, base);
+}
+
+size_t HardwareSerial::print(unsigned int val, int base) {
+    return printNumber(val, base);
+}
+
+size_t HardwareSerial::print(long val, int base) {
+    if (base == 10 && val < 0) return print('-') + printNumber(-(unsigned long)val, 10);
+    return printNumber(val, base);
+}
+
+size_t HardwareSerial::print(unsigned long val, int base) {
+    return printNumber(val, base);
+}
+
+size_t HardwareSerial::print(double val, int digits) {
+    char buf[40];
+
+    snprintf(buf, sizeof(buf), "%.*f", digits, val);
+    return print(buf);
+}
+
+size_t HardwareSerial::println(void) {
+    return print("\r\n");
+}
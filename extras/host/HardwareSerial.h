@@ -0,0 +1,77 @@
+/*
+ * si5351mcu - Si5351 library for Arduino MCU tuned for size and click-less
+ *
+ * Host (Linux) stand-in for the Arduino Serial port.
+ *
+ * Reads & writes a file descriptor (a pseudo terminal for the console test,
+ * stdin/stdout by default), just the print/read subset the examples use.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HOST_HARDWARESERIAL_H
+#define HOST_HARDWARESERIAL_H
+
+#include "Arduino.h"
+
+// same as the AVR core
+#define SERIAL_RX_BUFFER_SIZE 64
+
+class HardwareSerial {
+    private:
+        int     fdIn = 0;
+        int     fdOut = 1;
+        uint8_t rxBuf[SERIAL_RX_BUFFER_SIZE];
+        uint8_t rxLen = 0;
+        uint8_t rxPos = 0;
+
+        size_t  printNumber(unsigned long val, int base);
+
+    public:
+        // the port is a file descriptor (both ways), non blocking reads
+        void    attach(int fd);
+
+        // bytes read & written since the start
+        uint32_t bytesIn = 0;
+        uint32_t bytesOut = 0;
+
+        // the Arduino Serial API subset used by the examples
+        void    begin(unsigned long) {};
+        operator bool() { return true; };
+        int     available(void);
+        int     read(void);
+        size_t  write(uint8_t val);
+        size_t  write(const uint8_t *data, size_t len);
+
+        size_t  print(const char *str);
+        size_t  print(char c);
+        size_t  print(unsigned char val, int base = DEC);
+        size_t  print(int val, int base = DEC);
+        size_t  print(unsigned int val, int base = DEC);
+        size_t  print(long val, int base = DEC);
+        size_t  print(unsigned long val, int base = DEC);
+        size_t  print(double val, int digits = 2);
+
+        size_t  println(void);
+        template <class T> size_t println(T val) {
+            return print(val) + println();
+        }
+        template <class T> size_t println(T val, int base) {
+            return print(val, base) + println();
+        }
+};
+
+extern HardwareSerial Serial;
+
+#endif // HOST_HARDWARESERIAL_H
@@ -0,0 +1,130 @@
+/*
+ * si5351mcu - Si5351 library for Arduino MCU tuned for size and click-less
+ *
+ * Host (Linux) stand-in for the Arduino Wire (I2C) library.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Wire.h"
+#include "si5351sim.h"
+
+// the default bus, as in the Arduino core
+TwoWire Wire;
+
+Si5351sim *TwoWire::find(uint8_t addr) {
+    for (uint8_t i = 0; i < WIRE_DEVICES; i++) {
+        if (dev[i] && dev[i]->address == addr) return dev[i];
+    }
+    return 0;
+}
+
+void TwoWire::attach(Si5351sim &sim) {
+    for (uint8_t i = 0; i < WIRE_DEVICES; i++) {
+        if (!dev[i]) {
+            dev[i] = &sim;
+            return;
+        }
+    }
+}
+
+void TwoWire::detach(Si5351sim &sim) {
+    for (uint8_t i = 0; i < WIRE_DEVICES; i++) {
+        if (dev[i] == &sim) dev[i] = 0;
+    }
+}
+
+void TwoWire::fail(uint32_t n) {
+    failNext = n;
+}
+
+void TwoWire::failRate(uint32_t n, bool partial) {
+    failEvery = n;
+    failPartial = partial;
+}
+
+// a plain LCG, the same faults on each run
+uint32_t TwoWire::rnd(void) {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+void TwoWire::beginTransmission(uint8_t addr) {
+    txAddr = addr;
+    txLen = 0;
+    txOverflow = false;
+}
+
+size_t TwoWire::write(uint8_t val) {
+    if (txLen >= BUFFER_LENGTH) {
+        txOverflow = true;
+        return 0;
+    }
+    txBuf[txLen++] = val;
+    return 1;
+}
+
+size_t TwoWire::write(const uint8_t *data, size_t len) {
+    size_t n = 0;
+    while (len--) n += write(*data++);
+    return n;
+}
+
+/*
+ * Same return codes as the AVR core:
+ *  0: success
+ *  1: data too long to fit in transmit buffer
+ *  2: received NACK on transmit of address
+ *  3: received NACK on transmit of data
+ */
+uint8_t TwoWire::endTransmission(bool stop) {
+    Si5351sim *sim = find(txAddr);
+
+    (void)stop;
+    if (txOverflow) return 1;
+    if (!sim) return sinkOn ? 0 : 2;
+
+    // injected faults
+    if (failNext || (failEvery && rnd() % failEvery == 0)) {
+        if (failNext) failNext--;
+        faults++;
+        if (!failPartial || txLen < 2) return 2;
+        sim->i2cWrite(txBuf, 1 + rnd() % (txLen - 1));
+        return 3;
+    }
+
+    return sim->i2cWrite(txBuf, txLen);
+}
+
+uint8_t TwoWire::requestFrom(uint8_t addr, uint8_t len) {
+    Si5351sim *sim = find(addr);
+
+    if (len > BUFFER_LENGTH) len = BUFFER_LENGTH;
+    rxPos = 0;
+    if (!sim && sinkOn) {
+        memset(rxBuf, 0, len);
+        return rxLen = len;
+    }
+    rxLen = sim ? sim->i2cRead(rxBuf, len) : 0;
+    return rxLen;
+}
+
+int TwoWire::available(void) {
+    return rxLen - rxPos;
+}
+
+int TwoWire::read(void) {
+    if (rxPos >= rxLen) return -1;
+    return rxBuf[rxPos++];
+}
@@ -0,0 +1,93 @@
+/*
+ * si5351mcu - Si5351 library for Arduino MCU tuned for size and click-less
+ *
+ * Host (Linux) stand-in for the Arduino Wire (I2C) library.
+ *
+ * Transactions are not sent anywhere, they are delivered to the simulated
+ * devices attached to the bus (see si5351sim.h) by its I2C address, an
+ * address with no device attached gets a NACK just like the real thing.
+ *
+ * Bus faults can be injected on the write transactions (see fail() &
+ * failRate()) to check the lib recovers from them, and sink() ACKs & drops
+ * the transactions to an address with no device, to time the lib alone.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+
+#include "Arduino.h"
+
+// same as the AVR core
+#define BUFFER_LENGTH 32
+
+// max simulated devices per bus
+#define WIRE_DEVICES 4
+
+class Si5351sim;
+
+class TwoWire {
+    private:
+        Si5351sim *dev[WIRE_DEVICES] = { 0 };
+        uint8_t txAddr = 0;
+        uint8_t txBuf[BUFFER_LENGTH + 1];
+        uint8_t txLen = 0;
+        bool    txOverflow = false;
+        uint8_t rxBuf[BUFFER_LENGTH];
+        uint8_t rxLen = 0;
+        uint8_t rxPos = 0;
+
+        // fault injection & sink state
+        uint32_t failNext = 0;
+        uint32_t failEvery = 0;
+        bool     failPartial = false;
+        uint32_t seed = 1;
+        bool     sinkOn = false;
+
+        Si5351sim *find(uint8_t addr);
+        uint32_t   rnd(void);
+
+    public:
+        // hook a simulated device to this bus
+        void attach(Si5351sim &sim);
+        void detach(Si5351sim &sim);
+
+        // fault injection on the write transactions (register pointer
+        // writes of the reads too): the next n fail, or one in every n at
+        // random (0 = off); partial: the failed ones deliver part of the
+        // burst to the device before the NACK (a glitch mid burst), if not
+        // it's a NACK on the address and nothing gets there
+        void fail(uint32_t n);
+        void failRate(uint32_t n, bool partial = false);
+        uint32_t faults = 0;        // injected so far
+
+        // ACK & drop the transactions to an address with no device, reads
+        // get zeros
+        void sink(bool on) { sinkOn = on; }
+
+        // the Arduino Wire API subset used by the lib
+        void    begin(void) {};
+        void    beginTransmission(uint8_t addr);
+        size_t  write(uint8_t val);
+        size_t  write(const uint8_t *data, size_t len);
+        uint8_t endTransmission(bool stop = true);
+        uint8_t requestFrom(uint8_t addr, uint8_t len);
+        int     available(void);
+        int     read(void);
+};
+
+extern TwoWire Wire;
+
+#endif // HOST_WIRE_H
@@ -0,0 +1,336 @@
+/*
+ * si5351mcu - Si5351 library for Arduino MCU tuned for size and click-less
+ *
+ * Host (Linux) accuracy & speed suite: for each xtal from 24 to 28 MHz it
+ * sweeps the whole range (8 kHz to 225 MHz, 10 kHz to 250 MHz with the
+ * overclock) against the Si5351 register model, with fine steps at the
+ * range ends, around the ham band edges and around the R divider
+ * transitions; and it times the pure math of setFreq() & computeRegs().
+ *
+ * Build & run from the repository root, with and without the overclock:
+ *
+ *   g++ -O2 -Wno-narrowing -Iextras/host -Isrc src/si5351mcu.cpp \
+ *       extras/host/Arduino.cpp extras/host/Wire.cpp extras/host/si5351sim.cpp \
+ *       extras/host/si5351_accuracy.cpp -o si5351_accuracy
+ *   ./si5351_accuracy --baseline extras/host/si5351_accuracy.csv
+ *
+ *   (the same with -DSI_OVERCLOCK=1000000000L)
+ *
+ * The output is CSV, a row per xtal & segment:
+ *
+ *   xtal,oc,segment,points,max_err_hz,mean_err_hz,over_2hz,resets,
+ *   div_changes,bytes,calls_per_s
+ *
+ * max/mean_err_hz are the produced vs requested freq errors, over_2hz the
+ * points out of the +/- 2 Hz stated on the README, resets & div_changes
+ * the PLL resets and output divider (or R) changes, bytes the I2C bytes
+ * written; calls_per_s is only for the "math" segments (no bus).
+ *
+ * Options:
+ *
+ *   -v             a CSV row per setFreq() call instead (call,xtal,oc,
+ *                  segment,freq,out_hz,err_hz,div,r,reset,bytes)
+ *   --baseline F   compare with the rows of a previous run (same oc): any
+ *                  max error, over_2hz, resets or bytes increase is a
+ *                  regression
+ *   --speed        compare the calls_per_s too (a drop over 30%), only
+ *                  meaningful with a baseline made on the same machine
+ *
+ * Exit status is non zero if any freq is off by more than the tolerance
+ * (2 Hz, a bit more at VHF as the PLL fraction drops up to 32 Hz of the
+ * VCO) or on any regression against the baseline.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <time.h>
+#include "Wire.h"
+#include "si5351sim.h"
+#include "si5351mcu.h"
+
+#define TOLERANCE 2.0       // Hz
+
+#ifdef SI_OVERCLOCK
+    #define OC 1
+    #define F_MIN 10000L
+    #define F_MAX 250000000L
+#else
+    #define OC 0
+    #define F_MIN 8000L
+    #define F_MAX 225000000L
+#endif
+
+static const uint32_t xtals[] = {
+    24000000L, 25000000L, 26000000L, 27000000L, 28000000L
+};
+
+// the ham bands edges, from 160 m to 1.25 m
+static const uint32_t edges[] = {
+    1800000, 2000000, 3500000, 4000000, 5351500, 5366500, 7000000, 7300000,
+    10100000, 10150000, 14000000, 14350000, 18068000, 18168000, 21000000,
+    21450000, 24890000, 24990000, 28000000, 29700000, 50000000, 54000000,
+    144000000, 148000000, 220000000, 225000000
+};
+
+static Si5351sim sim;
+static Si5351mcu Si;
+static int failures = 0;
+static bool verbose = false;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// a result row
+struct row {
+    uint32_t xtal;
+    int oc;
+    char segment[16];
+    uint32_t points;
+    double max_err, sum_err;
+    uint32_t over, resets, divs, bytes;
+    double rate;
+};
+
+static row rows[256];
+static int nrows = 0;
+
+static row &new_row(uint32_t xtal, const char *segment) {
+    row &r = rows[nrows++];
+
+    memset(&r, 0, sizeof(r));
+    r.xtal = xtal;
+    r.oc = OC;
+    snprintf(r.segment, sizeof(r.segment), "%s", segment);
+    return r;
+}
+
+static void print_row(FILE *f, const row &r) {
+    fprintf(f, "%u,%d,%s,%u,%.3f,%.3f,%u,%u,%u,%u,%.0f\n",
+        r.xtal, r.oc, r.segment, r.points, r.max_err,
+        r.points ? r.sum_err / r.points : 0, r.over, r.resets, r.divs,
+        r.bytes, r.rate);
+}
+
+// a setFreq() on CLK0 and its outcome on the row
+static void step(row &r, uint32_t freq) {
+    uint32_t resets = sim.resets, bytes = sim.bytesWritten;
+    double div = sim.msDivider(0), rdiv = sim.rDivider(0);
+    double out, err, tol;
+
+    Si.setFreq(0, freq);
+
+    out = sim.outFreq(0);
+    err = fabs(out - freq);
+    tol = (double)freq * 32 / SI_VCO_MIN;
+    if (tol < TOLERANCE) tol = TOLERANCE;
+
+    r.points++;
+    r.sum_err += err;
+    if (err > r.max_err) r.max_err = err;
+    if (err > TOLERANCE) r.over++;
+    r.resets += sim.resets - resets;
+    r.bytes += sim.bytesWritten - bytes;
+    if (div != sim.msDivider(0) || rdiv != sim.rDivider(0)) r.divs++;
+
+    if (err > tol) {
+        if (failures++ < 10) {
+            fprintf(stderr, "FAIL xtal %u want %u Hz got %.3f Hz (err %.3f Hz)\n",
+                r.xtal, freq, out, out - freq);
+        }
+    }
+
+    if (verbose) {
+        printf("call,%u,%d,%s,%u,%.3f,%.3f,%.0f,%d,%u,%u\n", r.xtal, r.oc,
+            r.segment, freq, out, out - freq, sim.msDivider(0),
+            sim.rDivider(0), sim.resets - resets, sim.bytesWritten - bytes);
+    }
+}
+
+static void start(uint32_t xtal) {
+    Si.init(xtal);
+    sim.xtal = Si.getXtalCurrent();
+    Si.enable(0);
+}
+
+// the R bits for a freq, as the default output divider picks them
+static uint8_t rbits(uint32_t freq) {
+    Si5351regs regs;
+
+    Si.computeRegs(freq, regs);
+    return regs.ms[2] & 0x70;
+}
+
+static void sweep_xtal(uint32_t xtal) {
+    uint32_t f, lo, hi, mid;
+
+    // the whole range, up in 0.05% steps (and an odd Hz count)
+    row &all = new_row(xtal, "log-up");
+    start(xtal);
+    for (f = F_MIN; f <= F_MAX; f += f / 2000 + 7) step(all, f);
+
+    row &down = new_row(xtal, "log-down");
+    start(xtal);
+    for (f = F_MAX; f >= F_MIN; f -= f / 2000 + 7) step(down, f);
+
+    // 1 Hz steps at both ends of the range
+    row &ends = new_row(xtal, "ends");
+    start(xtal);
+    for (f = F_MIN; f < F_MIN + 1000; f++) step(ends, f);
+    start(xtal);
+    for (f = F_MAX - 1000; f <= F_MAX; f++) step(ends, f);
+
+    // 1 Hz steps around the band edges
+    row &band = new_row(xtal, "band-edges");
+    for (uint8_t i = 0; i < sizeof(edges) / sizeof(edges[0]); i++) {
+        if (edges[i] > F_MAX) continue;
+        start(xtal);
+        for (f = edges[i] - 500; f <= edges[i] + 500 && f <= F_MAX; f++) step(band, f);
+    }
+
+    // around the R divider transitions: find them by bisection on the
+    // default divider and sweep +/- 200 Hz at 1 Hz
+    row &rtr = new_row(xtal, "r-edges");
+    for (f = F_MIN; f < 1000000; f += f / 8) {
+        lo = f;
+        hi = f + f / 8;
+        if (rbits(lo) == rbits(hi)) continue;
+
+        while (hi - lo > 1) {
+            mid = lo + (hi - lo) / 2;
+            if (rbits(mid) == rbits(lo)) lo = mid; else hi = mid;
+        }
+
+        start(xtal);
+        for (mid = hi - 200; mid <= hi + 200; mid++) step(rtr, mid);
+        start(xtal);
+        for (mid = hi + 200; mid >= hi - 200; mid--) step(rtr, mid);
+    }
+}
+
+// the pure math, no bus at all
+static void math_xtal(uint32_t xtal) {
+    const uint32_t count = 200000;
+    volatile uint8_t sink = 0;
+    Si5351regs regs;
+    uint64_t t;
+
+    Si.init(xtal);
+    Wire.detach(sim);
+    Wire.sink(true);
+
+    // a tuning sweep, 10 Hz steps: the fast path most of the time
+    row &tune = new_row(xtal, "math-tune");
+    t = now_ns();
+    for (uint32_t i = 0; i < count; i++) Si.setFreq(0, 7000000 + i * 10);
+    tune.rate = count * 1e9 / (now_ns() - t);
+    tune.points = count;
+
+    // random jumps over the range: the full math every time
+    row &full = new_row(xtal, "math-full");
+    uint32_t seed = 1;
+    t = now_ns();
+    for (uint32_t i = 0; i < count; i++) {
+        seed = seed * 1103515245 + 12345;
+        Si.computeRegs(F_MIN + seed % (F_MAX - F_MIN), regs);
+        sink += regs.pll[7];
+    }
+    full.rate = count * 1e9 / (now_ns() - t);
+    full.points = count;
+
+    Wire.sink(false);
+    Wire.attach(sim);
+    (void)sink;
+}
+
+// compare with a previous run, the rows with the same xtal, oc & segment
+static void compare(const char *file, bool speed) {
+    FILE *f = fopen(file, "r");
+    char line[256], seg[16];
+    row b;
+    double mean;
+
+    if (!f) {
+        fprintf(stderr, "FAIL can't open the baseline %s\n", file);
+        failures++;
+        return;
+    }
+
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "%u,%d,%15[^,],%u,%lf,%lf,%u,%u,%u,%u,%lf", &b.xtal,
+                   &b.oc, seg, &b.points, &b.max_err, &mean, &b.over,
+                   &b.resets, &b.divs, &b.bytes, &b.rate) != 11) continue;
+        if (b.oc != OC) continue;
+
+        for (int i = 0; i < nrows; i++) {
+            row &r = rows[i];
+            if (r.xtal != b.xtal || strcmp(r.segment, seg)) continue;
+
+            if (r.max_err > b.max_err + 0.001 || r.over > b.over ||
+                r.resets > b.resets || r.bytes > b.bytes) {
+                fprintf(stderr, "REGRESSION %u %s: max err %.3f/%.3f, over 2 Hz "
+                    "%u/%u, resets %u/%u, bytes %u/%u (now/baseline)\n",
+                    r.xtal, seg, r.max_err, b.max_err, r.over, b.over,
+                    r.resets, b.resets, r.bytes, b.bytes);
+                failures++;
+            }
+            if (speed && b.rate > 0 && r.rate < b.rate * 0.7) {
+                fprintf(stderr, "REGRESSION %u %s: %.0f calls/s, baseline %.0f\n",
+                    r.xtal, seg, r.rate, b.rate);
+                failures++;
+            }
+        }
+    }
+
+    fclose(f);
+}
+
+int main(int argc, char **argv) {
+    const char *baseline = NULL;
+    bool speed = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-v")) {
+            verbose = true;
+        } else if (!strcmp(argv[i], "--speed")) {
+            speed = true;
+        } else if (!strcmp(argv[i], "--baseline") && i + 1 < argc) {
+            baseline = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [-v] [--baseline file.csv] [--speed]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    Wire.attach(sim);
+
+    for (uint8_t i = 0; i < sizeof(xtals) / sizeof(xtals[0]); i++) {
+        sweep_xtal(xtals[i]);
+        math_xtal(xtals[i]);
+    }
+
+    if (!verbose) {
+        printf("xtal,oc,segment,points,max_err_hz,mean_err_hz,over_2hz,resets,"
+               "div_changes,bytes,calls_per_s\n");
+        for (int i = 0; i < nrows; i++) print_row(stdout, rows[i]);
+    }
+
+    if (baseline) compare(baseline, speed);
+
+    fprintf(stderr, "%s: %d failures\n", failures ? "FAIL" : "PASS", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,1675 @@
+/*
+ * si5351mcu - Si5351 library for Arduino MCU tuned for size and click-less
+ *
+ * Host (Linux) benchmark: runs the lib against the Si5351 register model,
+ * times each call and checks the frequency the chip would produce.
+ *
+ * Build & run from the repository root:
+ *
+ *   g++ -O2 -Wno-narrowing -Iextras/host -Isrc src/si5351mcu.cpp \
+ *       extras/host/Arduino.cpp extras/host/Wire.cpp extras/host/si5351sim.cpp \
+ *       extras/host/si5351_bench.cpp -o si5351_bench
+ *   ./si5351_bench
+ *
+ * Build it also with -DSICHANNELS=8 to check the 8 outputs variants (the
+ * outputs of the Si instance), with
+ * -DSI_STATS (or -DSI_STATS_TIME) to check the lib counters and with
+ * -DSI_OVERCLOCK=1050000000L for the overclocked VCO range.
+ *
+ * Exit status is non zero if any produced frequency is off by more than
+ * the tolerance (2 Hz, as stated in the README; a bit more at VHF).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <time.h>
+#include "Wire.h"
+#include "si5351sim.h"
+#include "si5351mcu.h"
+#include "si5351fixed.h"
+
+#define TOLERANCE 2.0       // Hz
+
+static Si5351sim sim(27000000L);
+static Si5351sim simB(27000000L, 0x61), simC(25000000L);     // several chips
+static Si5351mcu Si;
+static int failures = 0;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// snapshot of the sim counters (all the chips) to report the cost of a call
+struct cost {
+    uint64_t ns;
+    uint32_t tr, bytes, resets, bits;
+
+    static uint32_t sum(uint32_t Si5351sim::*what) {
+        return sim.*what + simB.*what + simC.*what;
+    }
+
+    void start(void) {
+        tr = sum(&Si5351sim::transactions);
+        bytes = sum(&Si5351sim::bytesWritten) + sum(&Si5351sim::bytesRead);
+        resets = sum(&Si5351sim::resets);
+        bits = sum(&Si5351sim::bits);
+        ns = now_ns();
+    }
+
+    void report(const char *what) {
+        ns = now_ns() - ns;
+        printf("%-30s %4u tr %4u bytes %2u resets %6u us-bus %8.0f ns-cpu\n",
+            what, sum(&Si5351sim::transactions) - tr,
+            sum(&Si5351sim::bytesWritten) + sum(&Si5351sim::bytesRead) - bytes,
+            sum(&Si5351sim::resets) - resets,
+            (uint32_t)(((uint64_t)(sum(&Si5351sim::bits) - bits) * 1000000L) / SIM_I2C_HZ),
+            (double)ns);
+    }
+};
+
+// check the output of a clk against the requested freq; the PLL fraction
+// drops up to 32 Hz of the VCO, that's more than the 2 Hz at VHF with the
+// VCO at the bottom of the range
+static void check(uint8_t clk, uint32_t freq, Si5351sim &chip = sim) {
+    double out = chip.outFreq(clk);
+    double err = out - freq;
+    double tol = (double)freq * 32 / SI_VCO_MIN;
+
+    if (fabs(err) > (tol > TOLERANCE ? tol : TOLERANCE)) {
+        if (failures++ >= 10) return;
+        printf("  FAIL CLK%d want %u Hz got %.3f Hz (err %.3f Hz)\n",
+            clk, freq, out, err);
+    }
+}
+
+static void bench_calls(void) {
+    cost c;
+    char label[40];
+
+    printf("== single calls ==\n");
+
+    c.start();
+    Si.init();
+    c.report("init()");
+
+    // the board xtal is 1250 Hz low, and the lib is told so
+    sim.xtal = 27000000L - 1250;
+    c.start();
+    Si.correction(-1250);
+    c.report("correction(-1250)");
+
+    c.start();
+    Si.setFreq(0, 7100000);
+    c.report("setFreq(0, 7.1 MHz)");
+
+    c.start();
+    Si.enable(0);
+    c.report("enable(0)");
+    check(0, 7100000);
+
+    c.start();
+    Si.setFreq(0, 7100010);
+    c.report("setFreq(0, +10 Hz)");
+    check(0, 7100010);
+
+    c.start();
+    Si.setFreq(0, 14200000);
+    c.report("setFreq(0, 14.2 MHz)");
+    check(0, 14200000);
+
+    c.start();
+    Si.setPower(0, SIOUT_8mA);
+    c.report("setPower(0, 8mA)");
+
+    for (uint8_t clk = 1; clk < SICHANNELS; clk++) {
+        c.start();
+        Si.setFreq(clk, 145000000);
+        snprintf(label, sizeof(label), "setFreq(%d, 145 MHz)", clk);
+        c.report(label);
+
+        Si.enable(clk);
+        check(clk, 145000000);
+    }
+
+    c.start();
+    Si.disable(2);
+    c.report("disable(2)");
+
+    c.start();
+    Si.off();
+    c.report("off()");
+}
+
+// a tuning knob: small steps up, the most common use
+static void bench_tuning(uint32_t start, uint32_t step, uint32_t count) {
+    cost c;
+    char label[48];
+
+    Si.init();
+    sim.xtal = Si.getXtalCurrent();
+    Si.setFreq(0, start);
+    Si.enable(0);
+
+    c.start();
+    for (uint32_t i = 0; i < count; i++) {
+        Si.setFreq(0, start + i * step);
+        check(0, start + i * step);
+    }
+    snprintf(label, sizeof(label), "tune %u x %u Hz @ %.1f MHz",
+        count, step, start / 1e6);
+    c.report(label);
+}
+
+/*
+ * Reference: the full setFreq() math (v0.7.1) for the PLL bank, used to
+ * check the division free fast path gives the exact same registers and
+ * to compare the speed of both. The total output divider (MS * R) can be
+ * given, or 0 to pick it as v0.7.1 did.
+ */
+static void ref_pll(uint32_t freq, uint32_t xtal, uint32_t div, uint8_t *regs) {
+    uint8_t a, R = 1;
+    uint32_t b, c, f, fvco, outdivider;
+    uint32_t P1, P2, P3;
+
+    if (div) {
+        fvco = div * freq;
+    } else {
+        outdivider = SI_VCO_MAX / freq;
+        while (outdivider > 900) {
+            R = R * 2;
+            outdivider = outdivider / 2;
+        }
+        if (outdivider % 2) outdivider--;
+        fvco = outdivider * R * freq;
+    }
+
+    a = fvco / xtal;
+    b = (fvco % xtal) >> 5;
+    c = xtal >> 5;
+    f = (128 * b) / c;
+
+    P1 = 128 * a + f - 512;
+    P2 = 128 * b - f * c;
+    P3 = c;
+
+    regs[0] = (P3 & 0xFF00) >> 8;
+    regs[1] = P3 & 0xFF;
+    regs[2] = (P1 & 0x030000L) >> 16;
+    regs[3] = (P1 & 0xFF00) >> 8;
+    regs[4] = P1 & 0xFF;
+    regs[5] = ((P3 & 0x0F0000L) >> 12) | ((P2 & 0x0F0000) >> 16);
+    regs[6] = (P2 & 0xFF00) >> 8;
+    regs[7] = P2 & 0xFF;
+}
+
+// tuning in steps, the PLL bank must match the reference math every time
+static void bench_fastpath(uint32_t xtal, int32_t corr, uint32_t start, int32_t step, uint32_t count) {
+    uint8_t ref[8];
+    uint32_t freq = start;
+    uint32_t bad = 0;
+
+    Si.init(xtal);
+    Si.correction(corr);
+    sim.xtal = Si.getXtalCurrent();
+
+    for (uint32_t i = 0; i < count; i++, freq += step) {
+        Si.setFreq(0, freq);
+        ref_pll(freq, Si.getXtalCurrent(),
+            (uint32_t)(sim.msDivider(0) + 0.5) * sim.rDivider(0), ref);
+        if (memcmp(ref, &sim.reg[26], 8)) bad++;
+    }
+
+    printf("fast path xtal %u%+d, %.3f MHz %+d Hz x %u: %s\n",
+        xtal, corr, start / 1e6, step, count, bad ? "MISMATCH" : "ok");
+    if (bad) failures++;
+}
+
+// pure math speed: the old full math vs the lib on a detached bus
+static void bench_math(uint32_t start, uint32_t step, uint32_t count) {
+    uint8_t ref[8];
+    volatile uint8_t sink = 0;
+    uint64_t t0, t1, t2;
+
+    Si.init();
+    Wire.detach(sim);
+    Wire.sink(true);
+
+    t0 = now_ns();
+    for (uint32_t i = 0; i < count; i++) {
+        ref_pll(start + i * step, 27000000L, 0, ref);
+        sink += ref[7];
+    }
+    t1 = now_ns();
+    for (uint32_t i = 0; i < count; i++) {
+        Si.setFreq(0, start + i * step);
+    }
+    t2 = now_ns();
+
+    Wire.sink(false);
+    Wire.attach(sim);
+    (void)sink;
+
+    printf("math %u x %u Hz: full math %.1f ns/call, setFreq() %.1f ns/call (bus included)\n",
+        count, step, (double)(t1 - t0) / count, (double)(t2 - t1) / count);
+}
+
+// the divider v0.7.1 used for a freq: MS * R
+static uint32_t old_divider(uint32_t freq) {
+    uint32_t outdivider = SI_VCO_MAX / freq, R = 1;
+
+    while (outdivider > 900) {
+        R = R * 2;
+        outdivider = outdivider / 2;
+    }
+    if (outdivider % 2) outdivider--;
+
+    return outdivider * R;
+}
+
+// a sweep, resets per MHz with the divider planner vs the v0.7.1 rule
+static void bench_sweep(uint32_t from, uint32_t to, uint32_t step) {
+    uint32_t freq = from, old = 0, olddiv = 0, n = 0, r;
+    int32_t dir = to > from ? step : -(int32_t)step;
+    double mhz = fabs((double)to - from) / 1e6;
+
+    Si.init();
+    sim.xtal = Si.getXtalCurrent();
+    Si.enable(0);
+    r = sim.resets + 1;
+
+    while (n == 0 || (dir > 0 ? freq <= to : freq >= to)) {
+        Si.setFreq(0, freq);
+        check(0, freq);
+
+        if (old_divider(freq) != olddiv) {
+            olddiv = old_divider(freq);
+            old++;
+        }
+
+        freq += dir;
+        n++;
+    }
+
+    printf("sweep %7.3f > %7.3f MHz / %u Hz: %4u resets (%.2f/MHz), v0.7.1 %4u (%.2f/MHz)\n",
+        from / 1e6, to / 1e6, step, sim.resets - r,
+        (sim.resets - r) / mhz, old - 1, (old - 1) / mhz);
+}
+
+// a GPSDO like loop trimming the xtal correction: no resets, no MS writes
+static void bench_live(void) {
+    static const int32_t trims[] = { 0, -1, -3, 2, -250, 150, -1250 };
+    cost c;
+    char label[48];
+    uint8_t ms[16];
+
+    Si.init();
+    sim.xtal = Si.getXtalCurrent();
+    Si.setFreq(0, 7100000);
+    Si.setFreq(2, 10000000);
+    Si.enable(0);
+    Si.enable(2);
+    memcpy(ms, &sim.reg[42], 8);
+    memcpy(&ms[8], &sim.reg[58], 8);
+
+    for (uint8_t i = 0; i < sizeof(trims) / sizeof(trims[0]); i++) {
+        sim.xtal = Si.getXtalBase() + trims[i];
+        c.start();
+        Si.correctionLive(trims[i]);
+        snprintf(label, sizeof(label), "correctionLive(%d)", trims[i]);
+        c.report(label);
+        check(0, 7100000);
+        check(2, 10000000);
+    }
+
+    // 1 ppm high, 27 Hz
+    sim.xtal = Si.getXtalBase() + 27;
+    c.start();
+    Si.correctionPpb(1000);
+    c.report("correctionPpb(1000)");
+    check(0, 7100000);
+    check(2, 10000000);
+
+    if (memcmp(ms, &sim.reg[42], 8) || memcmp(&ms[8], &sim.reg[58], 8)) {
+        printf("  FAIL the output dividers were touched\n");
+        failures++;
+    }
+
+    // and setFreq() from there
+    Si.setFreq(0, 7100100);
+    check(0, 7100100);
+}
+
+// three chips: two on the same bus (0x60 & 0x61) and one on other bus,
+// retuned one by one (blocking) or in async mode with pumpAll()
+static TwoWire Wire1;
+static Si5351mcu SiB(Wire, 0x61), SiC(Wire1);
+
+static void multi_step(bool async, uint32_t f0, uint32_t f2, const char *what) {
+    Si5351mcu *chip[3] = { &Si, &SiB, &SiC };
+    Si5351sim *model[3] = { &sim, &simB, &simC };
+    cost c;
+    char label[48];
+    uint8_t passes = 0;
+
+    for (uint8_t i = 0; i < 3; i++) chip[i]->setAsync(async);
+
+    c.start();
+    for (uint8_t i = 0; i < 3; i++) {
+        chip[i]->begin();
+        chip[i]->setFreq(0, f0 - i * 1000);
+        chip[i]->setFreq(2, f2 - i * 1000);
+        chip[i]->commit();
+    }
+    while (Si5351mcu::pumpAll()) passes++;
+    snprintf(label, sizeof(label), "%s %s", async ? "pumpAll" : "blocking", what);
+    c.report(label);
+    if (async) printf("  %u pass(es) of pumpAll()\n", passes + 1);
+
+    for (uint8_t i = 0; i < 3; i++) {
+        check(0, f0 - i * 1000, *model[i]);
+        check(2, f2 - i * 1000, *model[i]);
+        chip[i]->setAsync(false);
+    }
+}
+
+static void bench_multi(void) {
+    Si5351mcu *chip[3] = { &Si, &SiB, &SiC };
+    Si5351sim *model[3] = { &sim, &simB, &simC };
+
+    Wire.attach(simB);
+    Wire1.attach(simC);
+
+    for (uint8_t a = 0; a < 2; a++) {
+        for (uint8_t i = 0; i < 3; i++) {
+            chip[i]->init(model[i]->xtal);
+            model[i]->xtal = chip[i]->getXtalCurrent();
+            chip[i]->setFreq(0, 16000000);
+            chip[i]->setFreq(2, 9000000);
+            chip[i]->enable(0);
+            chip[i]->enable(2);
+        }
+
+        multi_step(a, 16000100, 8999950, "3 chips LO+BFO step");
+        multi_step(a, 23000000, 12000000, "3 chips band change");
+    }
+
+    Wire.detach(simB);
+    Wire1.detach(simC);
+}
+
+// all the outputs at once: LO on CLK0, BFO on CLK2 & a calibration clock
+// on CLK1 (& more on the bigger chips) sharing the PLLs
+static void bench_alloc(void) {
+    // CLK6 & CLK7 are integer only: 900 MHz (the BFO VCO) / 36 & / 250
+    static const uint32_t more[] = { 0, 0, 0, 25000000, 12288000, 3579545, 25000000, 3600000 };
+    cost c;
+    char label[48];
+    uint32_t lo = 7100000, bfo = 8998500;
+
+    Si.init();
+    sim.xtal = Si.getXtalCurrent();
+
+    c.start();
+    if (!Si.setFreq(0, lo) || !Si.setFreq(2, 9000000) || !Si.setFreq(1, 10000000)) {
+        printf("  FAIL can't set LO, BFO & CAL\n");
+        failures++;
+    }
+    for (uint8_t i = 0; i < SICHANNELS; i++) {
+        if (i > 2 && !Si.setFreq(i, more[i])) {
+            printf("  FAIL can't set CLK%d to %u\n", i, more[i]);
+            failures++;
+        }
+        Si.enable(i);
+    }
+    snprintf(label, sizeof(label), "set & enable %d outputs", SICHANNELS);
+    c.report(label);
+
+    for (uint8_t i = 0; i < SICHANNELS; i++) {
+        printf("  CLK%d: PLL%c %s MS %.6f R %d\n", i, 'A' + sim.clkPll(i),
+            sim.clkInteger(i) ? "int " : "frac", sim.msDivider(i), sim.rDivider(i));
+    }
+
+    // tune the LO, the others must stay
+    c.start();
+    for (uint32_t i = 0; i < 1000; i++) {
+        lo += 10;
+        Si.setFreq(0, lo);
+    }
+    c.report("LO 1000 x 10 Hz, all on");
+    check(0, lo);
+    check(1, 10000000);
+    check(2, 9000000);
+    for (uint8_t i = 3; i < SICHANNELS; i++) check(i, more[i]);
+
+    // the BFO (owner of its PLL) moves, the ones following it too; but the
+    // integer only CLK6 & CLK7 can't follow it, must be refused
+    c.start();
+    if (Si.setFreq(2, bfo) != (SICHANNELS <= 6)) {
+        printf("  FAIL BFO move %s\n", SICHANNELS <= 6 ? "refused" : "must be refused");
+        failures++;
+    }
+    c.report("BFO -1.5 kHz, followers too");
+    if (SICHANNELS > 6) bfo = 9000000;
+    check(0, lo);
+    check(1, 10000000);
+    check(2, bfo);
+    for (uint8_t i = 3; i < SICHANNELS; i++) check(i, more[i]);
+
+    // can't be made from any of the VCOs: refused, nothing touched
+    if (Si.setFreq(1, 199999999)) {
+        printf("  FAIL 199.999999 MHz on a shared PLL must be refused\n");
+        failures++;
+    }
+    check(1, 10000000);
+
+    // a disabled output frees its PLL
+    Si.disable(2);
+    for (uint8_t i = 3; i < SICHANNELS; i++) Si.disable(i);
+    Si.setFreq(1, 144300000);
+    check(1, 144300000);
+    if (!sim.clkInteger(1)) {
+        printf("  FAIL CLK1 must own the free PLL (integer mode)\n");
+        failures++;
+    }
+    check(0, lo);
+
+    // an output enabled again is tracked again: the next ones can't take
+    // its PLL (CLK2 must follow)
+    Si.init();
+    Si.setFreq(0, 7100000);
+    Si.enable(0);
+    Si.disable(0);
+    if (!Si.enable(0)) {
+        printf("  FAIL enable(0) again refused\n");
+        failures++;
+    }
+    Si.setFreq(1, 10000000);
+    Si.enable(1);
+    Si.setFreq(2, 14123456);
+    Si.enable(2);
+    check(0, 7100000);
+    check(1, 10000000);
+    check(2, 14123456);
+
+    // but if both PLLs were taken meanwhile and it can't follow (200 MHz is
+    // not an integer or 8+ divider of any of them): refused, and left off
+    Si.init();
+    Si.setFreq(0, 200000000);
+    Si.enable(0);
+    Si.disable(0);
+    Si.setFreq(1, 10000000);
+    Si.enable(1);
+    Si.setFreq(2, 14123456);
+    Si.enable(2);
+    if (Si.enable(0) || Si.isEnabled(0)) {
+        printf("  FAIL enable(0) with its PLL taken must be refused\n");
+        failures++;
+    }
+    check(1, 10000000);
+    check(2, 14123456);
+}
+
+// the decoded state against the sim decoders, to the milli Hz
+static void state_check(const Si5351state &st, const char *what) {
+    for (uint8_t p = 0; p < 2; p++) {
+        if (fabs((double)st.vco[p] - sim.pllFreq(p) * 1000) > 1) {
+            printf("  FAIL %s PLL%c %llu mHz, want %.3f Hz\n", what, 'A' + p,
+                (unsigned long long)st.vco[p], sim.pllFreq(p));
+            failures++;
+        }
+    }
+
+    for (uint8_t i = 0; i < SICHANNELS; i++) {
+        if (fabs((double)st.clk[i].freq - sim.outFreq(i) * 1000) > 1) {
+            printf("  FAIL %s CLK%d %llu mHz, want %.3f Hz\n", what, i,
+                (unsigned long long)st.clk[i].freq, sim.outFreq(i));
+            failures++;
+        }
+    }
+}
+
+static void bench_state(void) {
+    static const uint32_t more[] = { 0, 0, 0, 25000000, 12288000, 3579545, 25000000, 3600000 };
+    Si5351state st;
+    cost c;
+
+    Si.init();
+    sim.xtal = Si.getXtalCurrent();
+
+    // LO, BFO & a fractional follower, plus the rest
+    Si.setFreq(0, 7100000);
+    Si.setFreq(2, 9000000);
+    Si.setFreq(1, 10000000);
+    for (uint8_t i = 0; i < SICHANNELS; i++) {
+        if (i > 2) Si.setFreq(i, more[i]);
+        Si.enable(i);
+    }
+    Si.setFreq(1, 10000017);
+
+    c.start();
+    if (!Si.readState(st)) {
+        printf("  FAIL readState()\n");
+        failures++;
+    }
+    c.report("readState()");
+    state_check(st, "all on");
+
+    // the old way: a register at a time
+    c.start();
+    for (uint8_t r = 0; r < 4; r++) Si.i2cRead(r);
+    for (uint8_t r = SI_SHADOW_FIRST; r <= SI_SHADOW_LAST; r++) Si.i2cRead(r);
+    c.report("same, register by register");
+
+    // divide by 4, big R and an output off
+    Si.setFreq(0, 200000000);
+    Si.setFreq(2, 10000);
+    Si.disable(1);
+    Si.readState(st);
+    state_check(st, "div by 4 & R");
+
+    printf("  PLLA x%llu.%06llu PLLB x%llu.%06llu (1e-6)\n",
+        (unsigned long long)(Si5351mcu::ratio(st.pll[0], 1000000) / 1000000),
+        (unsigned long long)(Si5351mcu::ratio(st.pll[0], 1000000) % 1000000),
+        (unsigned long long)(Si5351mcu::ratio(st.pll[1], 1000000) / 1000000),
+        (unsigned long long)(Si5351mcu::ratio(st.pll[1], 1000000) % 1000000));
+    if (fabs(Si5351mcu::ratio(st.pll[0], 1000000) / 1e6 - sim.pllRatio(0)) > 1e-6) {
+        printf("  FAIL PLLA ratio\n");
+        failures++;
+    }
+
+    // no chip there
+    Si5351mcu none(Wire, 0x6F);
+    if (none.readState(st) || none.i2cRead(0) != -1) {
+        printf("  FAIL readState() with no chip\n");
+        failures++;
+    }
+}
+
+// the MCU reboots but the chip keeps running
+static void bench_warm(void) {
+    cost c;
+    uint32_t w, r;
+
+    sim.powerOn();
+    c.start();
+    Si.init(27000000L);
+    c.report("cold init()");
+    sim.xtal = Si.getXtalCurrent();
+
+    // LO, BFO, a fractional follower & some power
+    Si.setFreq(0, 7100000);
+    Si.setFreq(2, 9000000);
+    Si.setFreq(1, 10000017);
+    for (uint8_t i = 0; i < 3; i++) Si.enable(i);
+    Si.setPower(2, SIOUT_8mA);
+
+    {
+        Si5351mcu boot;
+
+        w = sim.writes - sim.reads;     // a read sets the pointer with a write
+        r = sim.resets;
+        c.start();
+        if (!boot.initWarm()) {
+            printf("  FAIL initWarm() must find the chip running\n");
+            failures++;
+        }
+        c.report("warm initWarm()");
+        if (sim.writes - sim.reads != w) {
+            printf("  FAIL initWarm() wrote to a running chip\n");
+            failures++;
+        }
+        check(0, 7100000);
+        check(1, 10000017);
+        check(2, 9000000);
+        if (!boot.isEnabled(0) || !boot.isEnabled(1) || !boot.isEnabled(2) ||
+            boot.getPower(2) != SIOUT_8mA || boot.getPower(0) != Si.getPower(0)) {
+            printf("  FAIL initWarm() outputs state %d%d%d %d %d\n", boot.isEnabled(0),
+                boot.isEnabled(1), boot.isEnabled(2), boot.getPower(0), boot.getPower(2));
+            failures++;
+        }
+
+        // the same freqs again: nothing to send
+        c.start();
+        boot.setFreq(0, 7100000);
+        boot.setFreq(2, 9000000);
+        boot.setFreq(1, 10000017);
+        c.report("same freqs after it");
+        if (sim.writes - sim.reads != w) {
+            printf("  FAIL the same freqs after initWarm() must send nothing\n");
+            failures++;
+        }
+
+        // tuning goes on with no reset, the follower follows
+        c.start();
+        boot.setFreq(0, 7100010);
+        boot.setFreq(2, 8999000);
+        c.report("LO & BFO step after it");
+        check(0, 7100010);
+        check(1, 10000017);
+        check(2, 8999000);
+        if (sim.resets != r) {
+            printf("  FAIL a tuning step after initWarm() made a reset\n");
+            failures++;
+        }
+    }
+
+    // a chip just powered on: cold
+    sim.powerOn();
+    {
+        Si5351mcu boot;
+
+        c.start();
+        if (boot.initWarm()) {
+            printf("  FAIL initWarm() on a chip just powered on must be cold\n");
+            failures++;
+        }
+        c.report("initWarm() on power on");
+    }
+}
+
+// PLL lock polling, with a sim that takes a while to lock after a reset
+static void bench_lock(void) {
+    cost c;
+    int32_t t;
+    char label[48];
+
+    Si.init(27000000L);
+    sim.xtal = Si.getXtalCurrent();
+    Si.setFreq(0, 7100000);
+    Si.enable(0);
+    Si.sticky(true);
+
+    // small step, no reset: locked at once, a single read
+    c.start();
+    t = Si.waitLocked(10000);
+    c.report("waitLocked(), no reset");
+    if (t < 0 || t > 1000) {
+        printf("  FAIL waitLocked() with no reset took %d us\n", t);
+        failures++;
+    }
+
+    // a reset, the PLL takes 300 uS to lock
+    sim.lockMicros = 300;
+    Si.setFreq(0, 14100000);
+    c.start();
+    t = Si.waitLocked(10000);
+    snprintf(label, sizeof(label), "waitLocked(), reset: %d us", t);
+    c.report(label);
+    if (t < 300 || t > 5000) {
+        printf("  FAIL waitLocked() after a reset took %d us\n", t);
+        failures++;
+    }
+    check(0, 14100000);
+
+    // the sticky bits remember it, until cleared
+    if (!(Si.sticky(true) & SI_LOL_A) || Si.sticky() != 0) {
+        printf("  FAIL sticky LOL_A\n");
+        failures++;
+    }
+
+    // never locks in time
+    sim.lockMicros = 20000;
+    Si.reset();
+    if (Si.waitLocked(1000) != -1) {
+        printf("  FAIL waitLocked() must time out\n");
+        failures++;
+    }
+    if (!(Si.status() & SI_LOL_A)) {
+        printf("  FAIL status() LOL_A\n");
+        failures++;
+    }
+    sim.lockMicros = 0;
+    Si.reset();
+}
+
+#ifdef SI_STATS
+// the lib counters must match what the sim saw on the bus
+static void bench_stats(void) {
+    Si5351stats st;
+    Si5351state state;
+    uint32_t w, r, bw, br, rs;
+
+    Si.init(27000000L);
+    sim.xtal = Si.getXtalCurrent();
+    Si.resetStats();
+    w = sim.writes; r = sim.reads; rs = sim.resets;
+    bw = sim.bytesWritten; br = sim.bytesRead;
+
+    Si.setFreq(0, 7000000);
+    Si.enable(0);
+    for (uint32_t i = 1; i <= 1000; i++) Si.setFreq(0, 7000000 + i * 10);
+    Si.setFreq(0, 14000000);
+    Si.waitLocked(1000);
+    Si.readState(state);
+
+    st = Si.getStats();
+    printf("  %u calls, %u fast, %u full, %u resets, %u wr %u rd, %u+%u bytes, %u errors, %u retries, %u us\n",
+        st.calls, st.fast, st.full, st.resets, st.writes, st.reads,
+        st.bytesWritten, st.bytesRead, st.errors, st.retries, st.busMicros);
+
+    if (st.calls != 1002 || st.fast + st.full != st.calls || st.fast < 990 ||
+        st.writes != sim.writes - w || st.reads != sim.reads - r ||
+        st.resets != sim.resets - rs || st.errors || st.retries ||
+        st.bytesWritten != sim.bytesWritten - bw || st.bytesRead != sim.bytesRead - br) {
+        printf("  FAIL stats don't match the bus\n");
+        failures++;
+    }
+
+    // errors: no chip there, each transaction retried & failed
+    Si5351mcu none(Wire, 0x6F);
+    none.setFreq(0, 7000000);
+    none.i2cRead(0);
+    st = none.getStats();
+    if (!st.errors || st.errors * (1 + SI_I2C_RETRIES) != st.writes ||
+        st.retries != st.errors * SI_I2C_RETRIES) {
+        printf("  FAIL %u I2C errors %u retries, want %u & %u\n", st.errors, st.retries,
+            st.writes / (1 + SI_I2C_RETRIES), st.writes / (1 + SI_I2C_RETRIES) * SI_I2C_RETRIES);
+        failures++;
+    }
+
+    Si.resetStats();
+    if (Si.getStats().calls) {
+        printf("  FAIL resetStats()\n");
+        failures++;
+    }
+}
+#endif
+
+// ping-pong hopping on CLK0: prepare on the idle PLL, then hop
+static void bench_hop(uint32_t start, int32_t step, uint8_t count) {
+    cost c;
+    char label[48];
+
+    Si.init();
+    sim.xtal = Si.getXtalCurrent();
+    Si.setFreq(0, start);
+    Si.enable(0);
+
+    for (uint8_t i = 1; i <= count; i++) {
+        uint32_t next = start + i * step;
+
+        c.start();
+        if (!Si.hopPrepare(0, next)) {
+            printf("  hopPrepare(0, %u) refused\n", next);
+            failures++;
+            return;
+        }
+        snprintf(label, sizeof(label), "hopPrepare(0, %.4f MHz)", next / 1e6);
+        c.report(label);
+        check(0, next - step);
+
+        c.start();
+        if (!Si.hop(0)) {
+            printf("  FAIL hop(0) refused\n");
+            failures++;
+        }
+        snprintf(label, sizeof(label), "hop(0) -> PLL%c", 'A' + sim.clkPll(0));
+        c.report(label);
+        check(0, next);
+    }
+
+    // out of the actual divider range, must be refused
+    if (Si.hopPrepare(0, start / 2)) {
+        printf("  hopPrepare(0, %u) must be refused\n", start / 2);
+        failures++;
+    }
+
+    // nothing prepared (or no such output): nothing to hop to
+    if (Si.hop(0) || Si.hop(SICHANNELS) || Si.hopPrepare(SICHANNELS, start)) {
+        printf("  FAIL hop() with nothing prepared must be refused\n");
+        failures++;
+    }
+    check(0, start + count * step);
+
+    // the idle PLL is held from hopPrepare() to hop(): other output set in
+    // between must not land on it
+    Si.init();
+    Si.setFreq(0, start);
+    Si.enable(0);
+    Si.hopPrepare(0, start + step);
+    Si.setFreq(1, 10000000);
+    Si.enable(1);
+    if (!Si.hop(0)) {
+        printf("  FAIL hop(0) refused after setting CLK1\n");
+        failures++;
+    }
+    check(0, start + step);
+    check(1, 10000000);
+
+    // and the output is tracked at the new freq (a live correction)
+    Si.correctionLive(0);
+    check(0, start + step);
+}
+
+// register images: compile time, runtime & setFreq() must all agree
+static const uint32_t img_freqs[] = {
+    10000, 137500, 1838100, 7074000, 14097100, 14097101, 14097103, 14097104,
+    50313000, 144174000, 150000000, 200000000,
+};
+
+static constexpr Si5351regs img_table[] PROGMEM = {
+    SI5351_REGS(27000000L, 10000),      SI5351_REGS(27000000L, 137500),
+    SI5351_REGS(27000000L, 1838100),    SI5351_REGS(27000000L, 7074000),
+    SI5351_REGS(27000000L, 14097100),   SI5351_REGS(27000000L, 14097101),
+    SI5351_REGS(27000000L, 14097103),   SI5351_REGS(27000000L, 14097104),
+    SI5351_REGS(27000000L, 50313000),   SI5351_REGS(27000000L, 144174000),
+    SI5351_REGS(27000000L, 150000000),  SI5351_REGS(27000000L, 200000000),
+};
+
+static void bench_regs(void) {
+    cost c;
+    char label[48];
+    Si5351regs r;
+    uint8_t n = sizeof(img_freqs) / sizeof(img_freqs[0]);
+
+    Si.init(27000000L);
+    sim.xtal = Si.getXtalCurrent();
+    Si.enable(0);
+
+    // from a fresh start, as the planner keeps the last divider if it can
+    for (uint8_t i = 0; i < n; i++) {
+        Si.init(27000000L);
+        Si.computeRegs(img_freqs[i], r);
+        Si.setFreq(0, img_freqs[i]);
+        if (memcmp(&r, &img_table[i], sizeof(r)) ||
+            memcmp(r.pll, &sim.reg[26], 8) || memcmp(r.ms, &sim.reg[42], 8)) {
+            printf("  FAIL register image mismatch for %u Hz\n", img_freqs[i]);
+            failures++;
+        }
+    }
+
+    // the WSPR tones, from flash
+    Si.enable(0);
+    for (uint8_t i = 4; i < 8; i++) {
+        c.start();
+        Si.applyRegs_P(0, &img_table[i]);
+        snprintf(label, sizeof(label), "applyRegs_P(0, %u Hz)", img_freqs[i]);
+        c.report(label);
+        check(0, img_freqs[i]);
+    }
+
+    // and setFreq() must take over from there
+    Si.setFreq(0, 14097105);
+    check(0, 14097105);
+
+    // an image takes a PLL through the allocator: CLK2 moves to the free
+    // PLLA and CLK1 keeps PLLB; CLK0 can't have a PLL then, it's refused
+    Si.init(27000000L);
+    Si.setFreq(1, 10000000);
+    Si.enable(1);
+    Si.enable(2);
+    if (!Si.applyRegs_P(2, &img_table[4])) {
+        printf("  FAIL applyRegs() refused a free PLL\n");
+        failures++;
+    }
+    Si.setFreq(0, 7000000);
+    Si.enable(0);
+    if (Si.applyRegs_P(0, &img_table[5])) {
+        printf("  FAIL applyRegs() moved a shared PLL\n");
+        failures++;
+    }
+    check(0, 7000000);
+    check(1, 10000000);
+    check(2, img_freqs[4]);
+
+    // out of the divider math range: refused, the image untouched
+    static const uint32_t bad[] = { 0, SI_FREQ_MIN - 1, SI_FREQ_MAX + 1 };
+    for (uint8_t i = 0; i < 3; i++) {
+        memset(&r, 0x5A, sizeof(r));
+        if (Si.computeRegs(bad[i], r) || r.pll[0] != 0x5A || Si.setFreq(0, bad[i])) {
+            printf("  FAIL %u Hz must be refused\n", bad[i]);
+            failures++;
+        }
+    }
+    check(0, 7000000);
+}
+
+// a superhet: LO on CLK0 & BFO on CLK2 retuned together, one by one and
+// in a begin()/commit() transaction
+static void batch_step(bool batched, uint32_t lo, uint32_t bfo, const char *what) {
+    cost c;
+    char label[48];
+
+    c.start();
+    if (batched) Si.begin();
+    Si.setFreq(0, lo);
+    Si.setFreq(2, bfo);
+    if (batched && Si.commit()) failures++;
+    snprintf(label, sizeof(label), "%s %s", batched ? "batch" : "plain", what);
+    c.report(label);
+    check(0, lo);
+    check(2, bfo);
+}
+
+static void bench_batch(void) {
+    for (uint8_t b = 0; b < 2; b++) {
+        Si.init();
+        sim.xtal = Si.getXtalCurrent();
+        Si.setFreq(0, 16000000);
+        Si.setFreq(2, 9000000);
+        Si.enable(0);
+        Si.enable(2);
+
+        batch_step(b, 16000100, 8999950, "LO+BFO small step");
+        batch_step(b, 23000000, 12000000, "LO+BFO band change");
+    }
+
+    // a new divider resets just the PLL of the output, and a transaction
+    // with both gets a single reset with the two of them
+    uint32_t ra = sim.pllResets[0], rb = sim.pllResets[1], r = sim.resets;
+    Si.setFreq(0, 7000000);
+    if (sim.pllResets[0] != ra + 1 || sim.pllResets[1] != rb) {
+        printf("  FAIL a CLK0 divider change must reset just PLLA\n");
+        failures++;
+    }
+    Si.begin();
+    Si.setFreq(0, 14000000);
+    Si.setFreq(2, 5000000);
+    Si.commit();
+    if (sim.resets != r + 2 || sim.pllResets[0] != ra + 2 || sim.pllResets[1] != rb + 1) {
+        printf("  FAIL a transaction must reset both PLLs at once\n");
+        failures++;
+    }
+    check(0, 14000000);
+    check(2, 5000000);
+}
+
+// a fast knob spin in async mode: setFreq() from the "ISR", pump() from the
+// main loop every few steps, only the last freq must go out
+static void bench_async(uint32_t start, uint32_t step, uint32_t count, uint32_t every) {
+    cost c;
+    char label[48];
+    uint32_t freq = start;
+    uint64_t t, cpu = 0;
+
+    Si.init();
+    sim.xtal = Si.getXtalCurrent();
+    Si.setFreq(0, start);
+    Si.enable(0);
+    Si.setAsync(true);
+
+    c.start();
+    for (uint32_t i = 1; i <= count; i++) {
+        freq = start + i * step;
+        t = now_ns();
+        Si.setFreq(0, freq);
+        cpu += now_ns() - t;
+        if (i % every == 0) while (Si.pump());
+    }
+    while (Si.pump());
+    snprintf(label, sizeof(label), "async %u x %u Hz, pump / %u", count, step, every);
+    c.report(label);
+    check(0, freq);
+
+    printf("  setFreq() in async mode: %.1f ns/call\n", (double)cpu / count);
+
+    // and turning it off must flush
+    Si.setFreq(0, start);
+    Si.setAsync(false);
+    check(0, start);
+}
+
+// the high precision mode: error in milli Hz vs the default math, sub Hz
+// steps and the cost of a call
+static void bench_fine(void) {
+    static const uint32_t xtals[] = { 25000000L, 27000000L, 26000000L };
+    double worst = 0, worstInt = 0, err;
+    uint64_t f, t0, t1, t2;
+    uint32_t seed = 12345;
+    uint32_t n = 0, bad = 0;
+    double low = 8000;
+
+    // an overclocked VCO moves the bottom up (the divider & R max at 900 * 128)
+    if (SI_VCO_MAX / (900.0 * 128) > low) low = ceil(SI_VCO_MAX / (900.0 * 128));
+
+    for (uint8_t x = 0; x < 3; x++) {
+        Si.init(xtals[x]);
+        Si.correction(x ? -1250 : 0);
+        sim.xtal = Si.getXtalCurrent();
+        Si.enable(0);
+        Si.enable(1);
+
+        for (uint32_t i = 0; i < 2000; i++, n++) {
+            // log spread 8 kHz (or the bottom) to 225 MHz, random milli Hz
+            seed = seed * 1103515245 + 12345;
+            f = (uint64_t)(low * pow(225000000.0 / low, (seed >> 8) / 16777216.0)) * 1000;
+            seed = seed * 1103515245 + 12345;
+            f += (seed >> 8) % 1000;
+
+            Si.setFreqMilli(0, f);
+            err = fabs(sim.outFreq(0) - f / 1000.0);
+            if (err > worst) worst = err;
+            if (err > 0.01) bad++;
+
+            Si.setFreq(1, f / 1000);
+            err = fabs(sim.outFreq(1) - (double)(f / 1000));
+            if (err > worstInt) worstInt = err;
+        }
+    }
+    printf("setFreqMilli() x %u: worst %.6f Hz, setFreq() worst %.3f Hz\n",
+        n, worst, worstInt);
+    if (bad) {
+        printf("  FAIL %u freqs off by more than 0.01 Hz\n", bad);
+        failures++;
+    }
+
+    // 0.1 Hz steps on 40m, each one must be seen
+    Si.init();
+    sim.xtal = Si.getXtalCurrent();
+    Si.enable(0);
+    double last = 0;
+    bad = 0;
+    for (f = 7074000000ULL; f < 7074010000ULL; f += 100) {
+        Si.setFreqMilli(0, f);
+        if (sim.outFreq(0) - last < 0.09 || fabs(sim.outFreq(0) - f / 1000.0) > 0.001) bad++;
+        last = sim.outFreq(0);
+    }
+    printf("0.1 Hz steps at 7.074 MHz x 100: %s\n", bad ? "FAIL" : "ok");
+    if (bad) failures++;
+
+    // the live correction keeps the milli Hz
+    Si.setFreqMilli(0, 10000000123ULL);
+    Si.correctionLive(-2000);
+    sim.xtal = Si.getXtalCurrent();
+    if (fabs(sim.outFreq(0) - 10000000.123) > 0.001) {
+        printf("  FAIL correctionLive() lost the milli Hz: %.4f Hz\n", sim.outFreq(0));
+        failures++;
+    }
+
+    // the cost: setFreq() may take the fast path, setFreqMilli() never
+    Si.init();
+    Wire.detach(sim);
+    Wire.sink(true);
+    t0 = now_ns();
+    for (uint32_t i = 0; i < 100000; i++) Si.setFreq(0, 7000000 + i * 1000);
+    t1 = now_ns();
+    for (uint32_t i = 0; i < 100000; i++) Si.setFreqMilli(0, 7000000000ULL + i * 1000017ULL);
+    t2 = now_ns();
+    Wire.sink(false);
+    Wire.attach(sim);
+
+    printf("cost: setFreq() %.1f ns/call, setFreqMilli() %.1f ns/call (bus included)\n",
+        (double)(t1 - t0) / 100000, (double)(t2 - t1) / 100000);
+}
+
+// the sequencer: each step as setFreq() would do it, the resets where
+// planned, the bytes per step and the cost of a step vs setFreq()
+static void bench_seq(uint32_t from, uint32_t to, uint32_t step, uint16_t ringSize) {
+    static uint8_t ring[256];
+    Si5351seq seq(Si, ring, ringSize);
+    Si5351mcu ref(Wire, 0x61);
+    uint32_t n = 0, bad = 0, resets, refResets, bytes, refBytes, seen;
+    uint64_t t0, tseq, tset;
+    double err, worst = 0;
+
+    // the reference: setFreq() on the second chip
+    Wire.attach(simB);
+    Si.init();
+    ref.init(Si.getXtalCurrent());
+    sim.xtal = simB.xtal = Si.getXtalCurrent();
+    Si.enable(0);
+    ref.enable(0);
+
+    resets = sim.resets;
+    refResets = simB.resets;
+    bytes = sim.bytesWritten;
+    refBytes = simB.bytesWritten;
+    if (!seq.sweep(0, from, to, step, 0)) {
+        printf("  FAIL sweep()\n");
+        failures++;
+        return;
+    }
+    seen = seq.wasReset();
+
+    do {
+        ref.setFreq(0, seq.freq());
+        err = fabs(sim.outFreq(0) - simB.outFreq(0));
+        if (err > worst) worst = err;
+        if (err > 0.001 || sim.outFreq(0) == 0) bad++;
+        n++;
+
+        seq.tick();
+        if (seq.poll()) seen += seq.wasReset();
+    } while (seq.running());
+
+    printf("seq %u-%u Hz by %u, ring %u: %u steps %s (worst %.3f Hz), resets %u "
+        "(planned %u, setFreq %u), %.1f bytes/step (setFreq %.1f)\n",
+        from, to, step, ringSize, n, bad ? "MISMATCH" : "ok", worst,
+        sim.resets - resets - 1, seq.plannedResets(), simB.resets - refResets - 1,
+        (double)(sim.bytesWritten - bytes) / n, (double)(simB.bytesWritten - refBytes) / n);
+    if (bad || sim.resets - resets - 1 != seq.plannedResets() || seen != sim.resets - resets ||
+        n != (to > from ? to - from : from - to) / step + 1) failures++;
+
+    // the cost of a step: poll() vs setFreq(), the frames are computed
+    // ahead by the poll() calls with nothing due, 4 steps at a time (the
+    // 16 bytes ring holds just one)
+    Wire.detach(simB);
+    seq.sweep(0, from, to, step, 0, true);
+    tseq = 0;
+    for (uint32_t i = 0; i < n; i += 4) {
+        for (uint8_t j = 0; j < 64; j++) seq.poll();
+        t0 = now_ns();
+        for (uint8_t j = 0; j < 4; j++) {
+            seq.tick();
+            seq.poll();
+        }
+        tseq += now_ns() - t0;
+    }
+    Si.init();
+    t0 = now_ns();
+    for (uint32_t i = 0; i < n; i++) Si.setFreq(0, from < to ? from + i * step : from - i * step);
+    tset = now_ns() - t0;
+
+    printf("  poll() %.1f ns/step, setFreq() %.1f ns/step (bus included)\n",
+        (double)tseq / ((n + 3) & ~3), (double)tset / n);
+}
+
+// a looped list on a fixed dwell: the schedule and the wrap
+static void bench_seq_list(void) {
+    static const uint32_t freqs[] = { 14097100, 14097101, 14097103, 14097104, 7040100 };
+    uint8_t ring[16];
+    Si5351seq seq(Si, ring, sizeof(ring));
+    uint32_t t0, steps = 0;
+    int32_t late = 0;
+
+    Si.init();
+    sim.xtal = Si.getXtalCurrent();
+    Si.enable(0);
+
+    // the schedule starts inside list(), a step may come a uS "early"
+    t0 = micros();
+    seq.list(0, freqs, 5, 2000, true);
+    while (steps < 25) {
+        if (seq.poll()) {
+            int32_t lag = micros() - t0 - (steps + 1) * 2000;
+            if (lag > late) late = lag;
+            steps++;
+            if (fabs(sim.outFreq(0) - freqs[seq.index()]) > TOLERANCE ||
+                seq.freq() != freqs[steps % 5]) {
+                printf("  FAIL list step %u\n", steps);
+                failures++;
+                break;
+            }
+        }
+    }
+    seq.stop();
+
+    printf("seq list x5 looped, 2 mS dwell: %u steps, %u resets planned per pass, worst lag %d uS\n",
+        steps, seq.plannedResets(), late);
+    if (seq.plannedResets() != 2 || seq.running()) failures++;
+
+    // both PLLs in use by others: no PLL for CLK2, no sequence
+    t0 = seq.freq();
+    Si.setFreq(1, 10000000);
+    Si.enable(1);
+    if (seq.list(2, freqs, 5, 2000) || seq.running()) {
+        printf("  FAIL list on a shared PLL\n");
+        failures++;
+    }
+    check(0, t0);
+    check(1, 10000000);
+
+    // a step out of the divider range (0 Hz would divide by zero) is
+    // refused up front, in a list or at the end of a sweep, and the
+    // sequence playing is stopped: nothing on the output changes
+    static const uint32_t bad[] = { 7040100, 0, 14097100 };
+    seq.list(0, freqs, 5, 2000, true);
+    t0 = seq.freq();
+    if (seq.list(0, bad, 3, 2000, true) || seq.running() ||
+        seq.sweep(0, 7000000, 0, 1000000, 2000) || seq.running() ||
+        seq.sweep(0, 200000000, 300000000, 10000000, 2000) || seq.running() ||
+        seq.sweep(0, 7000000, 7100000, 0, 2000)) {
+        printf("  FAIL seq with a step out of range must be refused\n");
+        failures++;
+    }
+    for (uint8_t j = 0; j < 8; j++) seq.poll();
+    check(0, t0);
+}
+
+// quadrature I/Q on CLK0 & CLK1: 90 degrees, resets only on a new divider
+static void bench_quad(void) {
+    uint32_t f = 7000000, bytes, resets, sbytes, sresets;
+    uint32_t n = 1000, step = 10;
+    bool good = true;
+
+    Si.init();
+    sim.xtal = Si.getXtalCurrent();
+    Si.enable(0);
+    Si.enable(1);
+
+    // a pair
+    good &= Si.quadrature(0, 1, f);
+    if (!good || fabs(sim.outFreq(0) - f) > TOLERANCE || fabs(sim.outFreq(1) - f) > TOLERANCE ||
+        fabs(sim.clkPhase(1) - sim.clkPhase(0) - 90) > 1e-9) {
+        printf("  FAIL quadrature(0, 1, %u): I %.3f Q %.3f, %.3f deg\n", f,
+            sim.outFreq(0), sim.outFreq(1), sim.clkPhase(1) - sim.clkPhase(0));
+        failures++;
+        return;
+    }
+
+    // small retunes: just the PLL bytes, no resets, still 90 degrees
+    bytes = sim.bytesWritten; resets = sim.resets;
+    for (uint32_t i = 1; i <= n; i++) {
+        good &= Si.quadrature(0, 1, f + i * step);
+        if (fabs(sim.outFreq(1) - (f + i * step)) > TOLERANCE) good = false;
+    }
+    bytes = sim.bytesWritten - bytes; resets = sim.resets - resets;
+    good &= fabs(sim.clkPhase(1) - sim.clkPhase(0) - 90) < 1e-9 && resets == 0;
+
+    // the same on a single output
+    Si.disable(1);
+    Si.init();
+    Si.enable(0);
+    Si.setFreq(0, f);
+    sbytes = sim.bytesWritten; sresets = sim.resets;
+    for (uint32_t i = 1; i <= n; i++) Si.setFreq(0, f + i * step);
+    sbytes = sim.bytesWritten - sbytes; sresets = sim.resets - sresets;
+
+    printf("quad %u x %u Hz: %.1f bytes/step %u resets, single output %.1f bytes/step %u resets\n",
+        n, step, (double)bytes / n, resets, (double)sbytes / n, sresets);
+
+    // a new divider: one reset, both MS banks before it, still 90 degrees
+    Si.init();
+    Si.enable(0);
+    Si.enable(1);
+    good &= Si.quadrature(0, 1, f);
+    resets = sim.resets;
+    good &= Si.quadrature(0, 1, 14000000);
+    resets = sim.resets - resets;
+    good &= fabs(sim.outFreq(1) - 14000000) < TOLERANCE && resets == 1 &&
+        fabs(sim.clkPhase(1) - sim.clkPhase(0) - 90) < 1e-9;
+    printf("quad 7 > 14 MHz: %u reset, %.3f deg\n", resets, sim.clkPhase(1) - sim.clkPhase(0));
+
+    // setFreq() on I keeps the pair
+    good &= Si.setFreq(0, 14100000) && fabs(sim.outFreq(1) - 14100000) < TOLERANCE &&
+        fabs(sim.clkPhase(1) - sim.clkPhase(0) - 90) < 1e-9;
+
+    // a live correction keeps the pair too
+    Si.correctionLive(50);
+    good &= fabs(sim.outFreq(1) - sim.outFreq(0)) < 1e-6 && sim.outFreq(0) != 14100000 &&
+        fabs(sim.clkPhase(1) - sim.clkPhase(0) - 90) < 1e-9;
+    Si.correctionLive(0);
+    good &= fabs(sim.outFreq(1) - 14100000) < TOLERANCE &&
+        fabs(sim.clkPhase(1) - sim.clkPhase(0) - 90) < 1e-9;
+
+    // out of range: too low, the same clk twice, MS6/7
+    good &= !Si.quadrature(0, 1, 4000000) && !Si.quadrature(2, 2, f);
+#if SICHANNELS > 6
+    good &= !Si.quadrature(0, 6, f);
+
+    // CLK6 (even integer dividers only) on the VCO of I: a retune of I it
+    // can't follow is refused and the pair stays as it was
+    Si.init();
+    Si.enable(0);
+    Si.enable(1);
+    good &= Si.quadrature(0, 1, f) && Si.setFreq(2, 10000000) && Si.setFreq(6, 8820000);
+    good &= !Si.setFreq(0, 7100000) && Si.setFreq(0, f);
+    good &= fabs(sim.outFreq(1) - f) < TOLERANCE && fabs(sim.clkPhase(1) - sim.clkPhase(0) - 90) < 1e-9;
+#endif
+
+    if (!good) {
+        printf("  FAIL quadrature\n");
+        failures++;
+    }
+
+    Si.disable(0);
+    Si.disable(1);
+}
+
+// the compile time driver: the PLL registers must be the ones of the
+// reference math (so the reciprocals of the xtal are exact), the outputs on
+// freq; returns the mismatches
+template <class T>
+static uint32_t fixed_check(T &fx, Si5351sim &chip, uint32_t xtal, uint8_t clk,
+                            uint32_t start, double mul, int32_t step, uint32_t count) {
+    uint8_t ref[8];
+    uint32_t bad = 0;
+    double f = start;
+
+    fx.enable(clk);
+    for (uint32_t i = 0; i < count; i++, f = f * mul + step) {
+        if (!fx.setFreq(clk, (uint32_t)f)) {
+            bad++;
+            continue;
+        }
+        ref_pll((uint32_t)f, xtal, (uint32_t)(chip.msDivider(clk) + 0.5) * chip.rDivider(clk), ref);
+        if (memcmp(ref, &chip.reg[26 + 8 * chip.clkPll(clk)], 8)) bad++;
+        check(clk, (uint32_t)f, chip);
+    }
+
+    return bad;
+}
+
+static void bench_fixed(void) {
+    static Si5351fixed<27000000L> fx(Wire, 0x61);
+    static Si5351fixed<25000000L, 1000000000L, 6> fc(Wire1);
+    uint32_t bad = 0, n = 10000, resets, bytes, sresets, sbytes;
+    uint64_t t0, tfix, tlib;
+    volatile bool sink = false;
+
+    Wire.attach(simB);
+    Wire1.attach(simC);
+    simB.xtal = 27000000L;
+    simC.xtal = 25000000L;
+
+    fx.init();
+    fc.init();
+
+    // 10 kHz to 200 MHz up & down, and a tuning knob; CLK0 on PLLA, CLK1
+    // & CLK5 on PLLB
+    bad += fixed_check(fx, simB, 27000000L, 0, 10000, 1.01, 0, 990);
+    bad += fixed_check(fx, simB, 27000000L, 1, 200000000, 1 / 1.01, 0, 990);
+    bad += fixed_check(fx, simB, 27000000L, 0, 7000000, 1, 0, 1);
+    resets = simB.resets;
+    bytes = simB.bytesWritten;
+    bad += fixed_check(fx, simB, 27000000L, 0, 7000010, 1, 10, 999);
+    bad += fixed_check(fx, simB, 27000000L, 0, 7010000, 1, 1000, 3000);
+    bad += fixed_check(fx, simB, 27000000L, 0, 10010000, 1, -1000, 3000);
+    resets = simB.resets - resets;
+    bytes = simB.bytesWritten - bytes;
+    bad += fixed_check(fc, simC, 25000000L, 0, 10000, 1.01, 0, 990);
+    bad += fixed_check(fc, simC, 25000000L, 5, 7000000, 1, -10, 1000);
+
+    // the lib on the same knob: 10 Hz & 1 kHz steps up to 10 MHz & back
+    Si.init(27000000L);
+    sim.xtal = Si.getXtalCurrent();
+    Si.enable(0);
+    Si.setFreq(0, 7000000);
+    sresets = sim.resets;
+    sbytes = sim.bytesWritten;
+    for (uint32_t i = 1; i < 1000; i++) Si.setFreq(0, 7000000 + i * 10);
+    for (uint32_t i = 0; i < 3000; i++) Si.setFreq(0, 7010000 + i * 1000);
+    for (uint32_t i = 0; i < 3000; i++) Si.setFreq(0, 10010000 - i * 1000);
+    sresets = sim.resets - sresets;
+    sbytes = sim.bytesWritten - sbytes;
+
+    printf("Si5351fixed: %u mismatches, knob 7 > 10 > 7 MHz: %u resets %.1f bytes/step (lib %u, %.1f)\n",
+        bad, resets, bytes / 6999.0, sresets, sbytes / 6999.0);
+    if (bad || resets != sresets) failures++;
+
+    // the v0.7 rule: CLK1 & CLK2 share PLLB, the last one set or enabled
+    // owns it and the other is turned off (not left on a wrong freq)
+    fx.setFreq(0, 7100000);
+    fx.enable(0);
+    fx.setFreq(1, 10000000);
+    fx.enable(1);
+    fx.setFreq(2, 14123456);
+    fx.enable(2);
+    if (fx.clkOn[1] || !(simB.reg[17] & 0x80) || !fx.clkOn[0] || !fx.clkOn[2]) {
+        printf("  FAIL Si5351fixed: CLK1 left on with CLK2 on PLLB\n");
+        failures++;
+    }
+    check(0, 7100000, simB);
+    check(2, 14123456, simB);
+    fx.setFreq(1, 10000000);
+    fx.enable(1);
+    if (fx.clkOn[2] || !(simB.reg[18] & 0x80) || !fx.clkOn[1]) {
+        printf("  FAIL Si5351fixed: CLK2 left on with CLK1 on PLLB\n");
+        failures++;
+    }
+    check(1, 10000000, simB);
+
+    // out of range, no output & a freq of 0 (no division by zero)
+    if (fx.setFreq(0, 300000000) || fx.setFreq(3, 7000000) || fx.setFreq(0, 0) ||
+        Si.setFreq(0, 0) || Si.setFreq(SICHANNELS, 7000000)) {
+        printf("  FAIL setFreq() out of range\n");
+        failures++;
+    }
+
+    // the CPU time, no bus: a tuning knob & band jumps (a new divider
+    // each time, the full math on both); the two in turns and the best of
+    // 7 runs, a PC is a noisy place to time things
+    Wire.detach(simB);
+    Wire.detach(sim);
+    Wire.sink(true);
+    for (uint8_t jump = 0; jump < 2; jump++) {
+        uint32_t f0 = 7000000, f1 = jump ? 21000000 : 7000000, st = jump ? 0 : 10;
+        uint64_t bfix = ~0ULL, blib = ~0ULL;
+
+        for (uint8_t r = 0; r < 7; r++) {
+            t0 = now_ns();
+            for (uint32_t i = 0; i < n; i++) sink ^= fx.setFreq(0, (i & 1 ? f1 : f0) + i * st);
+            tfix = now_ns() - t0;
+            t0 = now_ns();
+            for (uint32_t i = 0; i < n; i++) sink ^= Si.setFreq(0, (i & 1 ? f1 : f0) + i * st);
+            tlib = now_ns() - t0;
+            if (tfix < bfix) bfix = tfix;
+            if (tlib < blib) blib = tlib;
+        }
+
+        printf("  %s: Si5351fixed %.1f ns/call, Si5351mcu %.1f ns/call (%.0f%%)\n",
+            jump ? "band jumps 7 <> 21 MHz" : "tune x 10 Hz", (double)bfix / n,
+            (double)blib / n, 100.0 * bfix / blib);
+    }
+    Wire.sink(false);
+    Wire.attach(sim);
+    Wire1.detach(simC);
+}
+
+// I2C faults injected on the bus: the lib must never leave the chip on a
+// wrong freq once a call says all is fine, and recover with no help
+static bool fault_ok(uint8_t clk, uint32_t freq) {
+    double tol = (double)freq * 32 / SI_VCO_MIN;
+
+    return fabs(sim.outFreq(clk) - freq) <= (tol > TOLERANCE ? tol : TOLERANCE);
+}
+
+static void bench_faults(void) {
+    uint32_t seed = 7, f[2] = { 7000000, 10000000 }, bad = 0, falses = 0, t0;
+    uint32_t faults, bytes;
+    bool good = true;
+
+    Si.init(27000000L);
+    sim.xtal = Si.getXtalCurrent();
+    Si.setFreq(0, 7000000);
+    Si.enable(0);
+
+    // a glitch: the retry gets it, nobody notices
+    Wire.fail(SI_I2C_RETRIES);
+    good &= Si.setFreq(0, 7000100) && !Si.isDirty() && fault_ok(0, 7000100);
+
+    // the PLL bank of a new divider lost for good: false, the next write of
+    // the same call sends it again & resets, so the chip is right anyway
+    Wire.fail(1 + SI_I2C_RETRIES);
+    good &= !Si.setFreq(0, 14000000);
+    bytes = sim.bytesWritten;
+    good &= Si.setFreq(0, 14000010) && !Si.isDirty() && fault_ok(0, 14000010);
+    printf("lost PLL bank: fixed in the same call, next one %u bytes\n", sim.bytesWritten - bytes);
+
+    // the last write of a call lost: dirty, sent again with the next write
+    Si.setFreq(1, 10000000);
+    Wire.fail(1 + SI_I2C_RETRIES);
+    good &= !Si.enable(1) && Si.isDirty() && !sim.clkPowered(1);
+    good &= Si.setFreq(1, 10000010) && sim.clkPowered(1) && fault_ok(1, 10000010);
+
+    // a fault storm, glitches mid burst: 2 outputs on random walks & band
+    // jumps; when a call says true the chip must be there
+    Wire.failRate(4, true);
+    faults = Wire.faults;
+    for (uint32_t i = 0; i < 4000; i++) {
+        uint8_t clk = i & 1;
+
+        seed = seed * 1103515245 + 12345;
+        if ((seed >> 8) % 50 == 0) {
+            f[clk] = 3000000 + (seed >> 8) % 50000000;
+        } else {
+            f[clk] += ((seed >> 8) % 2001) - 1000;
+        }
+        if (Si.setFreq(clk, f[clk])) {
+            if (Si.isDirty() || !fault_ok(clk, f[clk])) bad++;
+        } else {
+            falses++;
+        }
+    }
+    faults = Wire.faults - faults;
+
+    // the bus is fine again: one call and all is in place
+    Wire.failRate(0);
+    good &= Si.setFreq(0, f[0]) && !Si.isDirty() && fault_ok(0, f[0]) && fault_ok(1, f[1]);
+    printf("fault storm: 4000 calls, %u faults injected, %u calls false, %u wrong, recovered: %s\n",
+        faults, falses, bad, good ? "ok" : "NO");
+
+    // the same in async mode: pump() stops on a failed write, the next ones
+    // finish the job
+    Si.setAsync(true);
+    Wire.failRate(3, true);
+    for (uint32_t i = 0; i < 2000; i++) {
+        f[i & 1] += 37;
+        Si.setFreq(i & 1, f[i & 1]);
+        if (i % 5 == 0) Si.pump();
+    }
+    Wire.failRate(0);
+    t0 = 0;
+    while (Si.pump()) t0++;
+    good &= !Si.pending() && !Si.isDirty() && fault_ok(0, f[0]) && fault_ok(1, f[1]);
+    printf("async storm: 2000 calls, drained in %u pump() after the faults\n", t0);
+    Si.setAsync(false);
+
+    // a brown-out of the chip: resync() puts all back
+    sim.powerOn();
+    good &= Si.resync() && fault_ok(0, f[0]) && fault_ok(1, f[1]);
+
+    // a dead bus: bounded, all the calls return
+    Wire.fail(1000000);
+    t0 = micros();
+    good &= !Si.setFreq(0, 21000000) && !Si.off() && !Si.resync() && !Si.pump();
+    t0 = micros() - t0;
+    Wire.fail(0);
+    good &= Si.resync() && !Si.isDirty() && !sim.clkPowered(0);
+    good &= Si.enable(0) && fault_ok(0, 21000000);
+    printf("dead bus: 4 calls returned in %u us, then resync()\n", t0);
+
+    // a band change lost and then a knob step whose flush fails too: the
+    // fast path bytes of the step must not go on top of a chip that missed
+    // the new divider (if the step needs more writes the next ones recover
+    // the chip), the next call puts all in place
+    Wire.fail(1000000);
+    good &= !Si.setFreq(0, 7000000) && Si.isDirty();
+    Wire.fail(1 + SI_I2C_RETRIES);
+    bytes = sim.bytesWritten;
+    good &= !Si.setFreq(0, 7000010);
+    good &= Si.isDirty() ? sim.bytesWritten == bytes : fault_ok(0, 7000010);
+    good &= Si.setFreq(0, 7000020) && !Si.isDirty() && fault_ok(0, 7000020);
+    printf("failed flush: the next write held back, %u bytes on the chip\n", sim.bytesWritten - bytes);
+
+    // a brown-out under a quadrature pair, with the spread spectrum on after
+    // it: the recovery sends them again too (out of the shadow range)
+    Si.enable(1);
+    good &= Si.quadrature(0, 1, 7100000);
+    sim.powerOn();
+    sim.reg[149] |= 0x80;
+    good &= Si.resync() && !sim.sscEnabled() && fault_ok(1, 7100000) &&
+        fabs(sim.clkPhase(1) - sim.clkPhase(0) - 90) < 1e-9;
+    printf("brown-out under a quadrature pair: %.3f deg after resync()\n",
+        sim.clkPhase(1) - sim.clkPhase(0));
+
+    // the spread spectrum read fails on init(): reg 149 must be left alone,
+    // not written from the -1 of the failed read
+    sim.reg[149] = 0x12;
+    Wire.fail(1 + SI_I2C_RETRIES);
+    Si.init();
+    good &= sim.reg[149] == 0x12;
+
+    if (bad || !good) {
+        printf("  FAIL I2C fault recovery\n");
+        failures++;
+    }
+
+    Si.off();
+}
+
+int main(void) {
+    Wire.attach(sim);
+
+    bench_calls();
+
+    printf("== tuning ==\n");
+    bench_tuning(7000000, 10, 1000);
+    bench_tuning(7000000, 1000, 1000);
+    bench_tuning(60000000, 10000, 200);
+
+    printf("== sweeps ==\n");
+    bench_sweep(1000000, 30000000, 1000);
+    bench_sweep(30000000, 1000000, 1000);
+    bench_sweep(60000000, 62000000, 10000);
+    bench_sweep(100000, 1000000, 100);
+    bench_sweep(100000000, 200000000, 10000);
+
+    printf("== several chips ==\n");
+    bench_multi();
+
+    printf("== PLL allocator ==\n");
+    bench_alloc();
+
+    printf("== state readback ==\n");
+    bench_state();
+
+    printf("== warm start ==\n");
+    bench_warm();
+
+    printf("== PLL lock ==\n");
+    bench_lock();
+
+#ifdef SI_STATS
+    printf("== stats ==\n");
+    bench_stats();
+#endif
+
+    printf("== live correction ==\n");
+    bench_live();
+
+    printf("== hopping ==\n");
+    bench_hop(7100000, -25000, 4);
+
+    printf("== sequencer ==\n");
+    bench_seq(1000000, 30000000, 10000, 64);
+    bench_seq(30000000, 1000000, 1000, 16);
+    bench_seq(144000000, 148000000, 12500, 256);
+    bench_seq_list();
+
+    printf("== quadrature ==\n");
+    bench_quad();
+
+    printf("== compile time driver ==\n");
+    bench_fixed();
+
+    printf("== I2C faults ==\n");
+    bench_faults();
+
+    printf("== batched writes ==\n");
+    bench_batch();
+    bench_async(7000000, 10, 1000, 1);
+    bench_async(7000000, 10, 1000, 20);
+
+    printf("== register images ==\n");
+    bench_regs();
+
+    printf("== fast path ==\n");
+    bench_fastpath(27000000L, 0, 7000000, 1, 20000);
+    bench_fastpath(27000000L, -1250, 7000000, 37, 20000);
+    bench_fastpath(25000000L, 311, 14000000, -10, 20000);
+    bench_fastpath(26000000L, 0, 10000, 1, 5000);
+    bench_fastpath(27000000L, 0, 144000000, 1000, 5000);
+    bench_fastpath(25000000L, 0, 3500000, 997, 20000);
+    bench_math(7000000, 10, 1000000);
+
+    printf("== high precision ==\n");
+    bench_fine();
+
+    printf("%s: %d failures\n", failures ? "FAIL" : "PASS", failures);
+    return failures ? 1 : 0;
+}
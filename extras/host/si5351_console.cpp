@@ -0,0 +1,399 @@
+/*
+ * si5351mcu - Si5351 library for Arduino MCU tuned for size and click-less
+ *
+ * Host (Linux) test of the serial console example: the sketch runs as is
+ * with its Serial port on a pseudo terminal and the lib on the Si5351
+ * register model, this side plays the PC: it tunes with the text commands
+ * and with the binary frames and measures the retunes per second.
+ *
+ * Build & run from the repository root:
+ *
+ *   g++ -O2 -Wno-narrowing -Wno-write-strings -Iextras/host -Isrc \
+ *       src/si5351mcu.cpp extras/host/Arduino.cpp extras/host/Wire.cpp \
+ *       extras/host/si5351sim.cpp extras/host/HardwareSerial.cpp \
+ *       extras/host/si5351_console.cpp -o si5351_console
+ *   ./si5351_console
+ *
+ * The host runs way faster than a MCU and the pty has no baud rate, so for
+ * each mode it also reports the serial bytes & I2C traffic per retune and
+ * the retunes per second they allow at 115200 bps and 100 kHz I2C, that's
+ * the real world limit. In binary mode the I2C figures are after the latest
+ * wins merge of the async mode, with frames coming this fast most of them
+ * are merged; a real MCU merges less.
+ *
+ * Exit status is non zero if a command fails, an ack is missing or wrong
+ * or the chip doesn't end on the last frequency sent.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include "Wire.h"
+#include "si5351sim.h"
+
+// the sketch sets a 25 MHz xtal
+static Si5351sim sim(25000000L);
+
+// the sketch itself, setup() & loop() are called from here
+#include "../../examples/si5351_serial_console/si5351_serial_console.ino"
+
+#define SERIAL_BPS  115200L
+#define WINDOW      8           // binary frames in flight
+#define TOLERANCE   2.0         // Hz
+
+static int pc;                  // the PC side of the pty
+static int failures = 0;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void fail(const char *what) {
+    if (failures++ < 10) printf("  FAIL %s\n", what);
+}
+
+// what the sketch sent so far, up to len bytes; the loop() runs while
+// waiting so this is the MCU & the PC at once
+static size_t pcRead(uint8_t *buf, size_t len) {
+    ssize_t n;
+
+    loop();
+    n = read(pc, buf, len);
+    return n > 0 ? n : 0;
+}
+
+static void pcWrite(const void *data, size_t len) {
+    if (write(pc, data, len) != (ssize_t)len) fail("pty write");
+}
+
+// wait for a text in the sketch output (discarding it all), false on a
+// timeout
+static bool pcExpect(const char *text) {
+    static char buf[4096];
+    static size_t have = 0;
+    uint32_t t0 = millis();
+    char *p;
+
+    while (millis() - t0 < 2000) {
+        have += pcRead((uint8_t *)buf + have, sizeof(buf) - 1 - have);
+        buf[have] = 0;
+        if ((p = strstr(buf, text))) {
+            p += strlen(text);
+            have -= p - buf;
+            memmove(buf, p, have);
+            return true;
+        }
+        if (have > sizeof(buf) / 2) {
+            memmove(buf, buf + have / 2, have - have / 2);
+            have -= have / 2;
+        }
+    }
+
+    return false;
+}
+
+// serial traffic & chip work so far, to report a run
+struct run {
+    uint64_t ns;
+    uint32_t in, out, tr, bits, resets;
+
+    void start(void) {
+        in = Serial.bytesIn;
+        out = Serial.bytesOut;
+        tr = sim.transactions;
+        bits = sim.bits;
+        resets = sim.resets;
+        ns = now_ns();
+    }
+
+    void report(const char *what, uint32_t retunes) {
+        double bin, bout, bbits, sec = (now_ns() - ns) / 1e9;
+
+        bin = (double)(Serial.bytesIn - in) / retunes;
+        bout = (double)(Serial.bytesOut - out) / retunes;
+        bbits = (double)(sim.bits - bits) / retunes;
+        printf("%-22s %6u retunes %9.0f /s host, serial %5.1f in %5.1f out, "
+            "I2C %4.2f tr %5.1f bits %2u resets: %5.0f /s at %ld bps, %5.0f /s at %ld Hz I2C\n",
+            what, retunes, retunes / sec, bin, bout,
+            (double)(sim.transactions - tr) / retunes, bbits, sim.resets - resets,
+            SERIAL_BPS / 10.0 / (bin > bout ? bin : bout), SERIAL_BPS,
+            bbits ? SIM_I2C_HZ / bbits : 0.0, SIM_I2C_HZ);
+    }
+};
+
+static void checkFreq(uint8_t clk, double freq, double tol, const char *what) {
+    double out = sim.outFreq(clk);
+
+    if (fabs(out - freq) > tol) {
+        char buf[120];
+        snprintf(buf, sizeof(buf), "%s: CLK%d want %.3f Hz got %.3f Hz", what, clk, freq, out);
+        fail(buf);
+    }
+}
+
+// the text commands, a line at a time as a person would
+static void textMode(uint32_t start, uint32_t step, uint32_t count) {
+    char line[32];
+    run r;
+
+    pcWrite("CHAN 0\r", 7);
+    pcWrite("ENA\r", 4);
+    if (!pcExpect("OK") || !pcExpect("OK")) fail("text CHAN/ENA");
+
+    r.start();
+    for (uint32_t i = 0; i < count; i++) {
+        snprintf(line, sizeof(line), "FRQ %u\r", start + i * step);
+        pcWrite(line, strlen(line));
+        if (!pcExpect("OK\r\n0:> ")) {
+            fail("text FRQ, no OK");
+            return;
+        }
+    }
+    r.report("text FRQ", count);
+    checkFreq(0, start + (count - 1) * step, TOLERANCE, "text FRQ");
+}
+
+// a binary frame
+static size_t frame(uint8_t *f, uint8_t seq, uint8_t cmd, const uint8_t *data, uint8_t len) {
+    uint8_t sum = seq ^ cmd ^ len;
+
+    f[0] = BIN_SYNC;
+    f[1] = seq;
+    f[2] = cmd;
+    f[3] = len;
+    for (uint8_t i = 0; i < len; i++) {
+        f[4 + i] = data[i];
+        sum ^= data[i];
+    }
+    f[4 + len] = sum;
+
+    return 5 + len;
+}
+
+static uint8_t *putLong(uint8_t *p, uint32_t val) {
+    for (uint8_t i = 0; i < 4; i++) *p++ = val >> (8 * i);
+    return p;
+}
+
+// send a frame and wait for its ack, returns the ack or -1 on a timeout
+static int binCall(uint8_t seq, uint8_t cmd, const uint8_t *data, uint8_t len) {
+    uint8_t f[BIN_MAX], ack;
+    uint32_t t0 = millis();
+
+    pcWrite(f, frame(f, seq, cmd, data, len));
+    while (millis() - t0 < 1000) {
+        if (pcRead(&ack, 1)) return ack;
+    }
+
+    return -1;
+}
+
+// pipelined binary retunes: up to WINDOW frames in flight, the acks are
+// matched by the sequence number; clks retuned in turns, n per frame
+// ('L' if more than one)
+static void binaryMode(const char *what, uint32_t start, uint32_t step, uint32_t count, uint8_t n) {
+    uint8_t f[BIN_MAX], data[BIN_MAX], *p, acks[64];
+    uint32_t sent = 0, acked = 0, t0;
+    uint8_t seq = 0, next = 0;
+    size_t got;
+    run r;
+
+    r.start();
+    while (acked < count) {
+        while (sent < count && sent - acked < WINDOW) {
+            p = data;
+            for (uint8_t c = 0; c < n; c++) {
+                *p++ = c;
+                p = putLong(p, start + sent * step + c * 1000000L);
+            }
+            if (n == 1) {
+                pcWrite(f, frame(f, seq, 'F', data, p - data));
+            } else {
+                pcWrite(f, frame(f, seq, 'L', data, p - data));
+            }
+            seq = (seq + 1) & 0x7F;
+            sent++;
+        }
+
+        t0 = millis();
+        do {
+            got = pcRead(acks, sizeof(acks));
+        } while (!got && millis() - t0 < 1000);
+        if (!got) {
+            fail("binary, ack timeout");
+            return;
+        }
+        for (size_t i = 0; i < got; i++, acked++) {
+            if (acks[i] != next) {
+                char buf[60];
+                snprintf(buf, sizeof(buf), "%s: ack %02X, want %02X", what, acks[i], next);
+                fail(buf);
+                return;
+            }
+            next = (next + 1) & 0x7F;
+        }
+    }
+
+    // the last writes out
+    while (Si.pending()) loop();
+    r.report(what, count * n);
+
+    for (uint8_t c = 0; c < n; c++) {
+        checkFreq(c, start + (count - 1) * step + c * 1000000L, TOLERANCE, what);
+    }
+}
+
+// wait for n bytes from the sketch, returns how many came
+static size_t pcGet(uint8_t *buf, size_t n) {
+    uint32_t t0 = millis();
+    size_t got = 0;
+
+    while (got < n && millis() - t0 < 1000) got += pcRead(buf + got, n - got);
+    return got;
+}
+
+// the other binary commands and the errors
+static void binaryCommands(void) {
+    uint8_t d[16], f[BIN_MAX], r[9];
+    uint64_t milli = 10000000123ULL;
+    uint32_t t0;
+
+    // enable, power, milli Hz
+    for (d[0] = 1, d[1] = 1; d[0] < 3; d[0]++) {
+        if (binCall(d[0], 'E', d, 2) != d[0] || !Si.clkOn[d[0]]) fail("binary 'E'");
+    }
+    d[0] = 1;
+    d[1] = 3;
+    if (binCall(2, 'P', d, 2) != 2) fail("binary 'P'");
+    d[0] = 0;
+    putLong(putLong(d + 1, milli & 0xFFFFFFFF), milli >> 32);
+    if (binCall(3, 'M', d, 9) != 3) fail("binary 'M'");
+    while (Si.pending()) loop();
+    if (sim.clkDrive(1) != 3) fail("binary 'P', power not set");
+    checkFreq(0, milli / 1000.0, 0.001, "binary 'M'");
+
+    // status: the ack, LEN & status, sticky, enabled outputs, resets (from
+    // the lib counters, 0 without them)
+#ifdef SI_STATS
+    uint32_t resets = Si.getStats().resets;
+#else
+    uint32_t resets = 0;
+#endif
+    pcWrite(f, frame(f, 4, 'S', d, 0));
+    if (pcGet(r, 9) != 9 || r[0] != 4 || r[1] != 7 || (r[4] & 7) != 7 ||
+        (uint32_t)(r[5] | r[6] << 8 | r[7] << 16 | r[8] << 24) != resets) {
+        fail("binary 'S'");
+    }
+
+    // bad sum
+    d[0] = 0;
+    putLong(d + 1, 7000000);
+    frame(f, 5, 'F', d, 5);
+    f[9] ^= 1;
+    pcWrite(f, 10);
+    if (pcGet(r, 1) != 1 || r[0] != (5 | 0x80)) fail("binary bad sum");
+
+    // unknown command, bad clk, short data
+    if (binCall(6, 'X', d, 5) != (6 | 0x80)) fail("binary unknown command");
+    d[0] = SICHANNELS;
+    if (binCall(7, 'F', d, 5) != (7 | 0x80)) fail("binary bad clk");
+    d[0] = 0;
+    if (binCall(8, 'F', d, 3) != (8 | 0x80)) fail("binary short data");
+
+    // a frame too big is dropped at the LEN
+    f[0] = BIN_SYNC;
+    f[1] = 9;
+    f[2] = 'L';
+    f[3] = 200;
+    pcWrite(f, 4);
+    if (pcGet(r, 1) != 1 || r[0] != (9 | 0x80)) fail("binary big frame");
+
+    // a frame with its LEN lost on the line: dropped after the gap, the
+    // next one is taken on its own (not as the rest of it)
+    pcWrite(f, 3);
+    t0 = millis();
+    while (millis() - t0 < 2 * BIN_TIMEOUT) pcRead(r, sizeof(r));
+    d[0] = 0;
+    putLong(d + 1, 7000000);
+    if (binCall(10, 'F', d, 5) != 10) fail("binary frame after a lost LEN");
+
+    // an output that can't be enabled (its PLL taken meanwhile and it
+    // can't follow the others) is nacked, 'E' & 'P'
+    Si.init();
+    Si.setFreq(0, 200000000);
+    Si.enable(0);
+    Si.disable(0);
+    Si.setFreq(1, 10000000);
+    Si.setFreq(2, 14123456);
+    Si.enable(1);
+    Si.enable(2);
+    d[0] = 0;
+    d[1] = 1;
+    if (binCall(11, 'E', d, 2) != (11 | 0x80) || Si.clkOn[0]) fail("binary 'E' refused");
+    d[1] = 3;
+    if (binCall(12, 'P', d, 2) != (12 | 0x80) || Si.clkOn[0]) fail("binary 'P' refused");
+    Si.disable(2);
+    if (binCall(13, 'E', d, 2) != 13 || !Si.clkOn[0]) fail("binary 'E' free PLL");
+    while (Si.pending()) loop();
+    checkFreq(0, 200000000, TOLERANCE, "binary 'E' free PLL");
+    Si.setFreq(0, 7000000);
+    Si.enable(2);
+
+    // and the text commands still work after all that (the prompt too, or
+    // it's taken as acks by the next run)
+    pcWrite("CHAN 0\r", 7);
+    if (!pcExpect("OK\r\n0:> ")) fail("text after binary");
+}
+
+int main(void) {
+    struct termios tio;
+    int mcu;
+
+    Wire.attach(sim);
+
+    // the pty, raw both ways: the MCU side is the sketch Serial
+    pc = posix_openpt(O_RDWR | O_NOCTTY);
+    if (pc < 0 || grantpt(pc) || unlockpt(pc) ||
+        (mcu = open(ptsname(pc), O_RDWR | O_NOCTTY)) < 0) {
+        perror("pty");
+        return 2;
+    }
+    tcgetattr(mcu, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(mcu, TCSANOW, &tio);
+    fcntl(pc, F_SETFL, fcntl(pc, F_GETFL) | O_NONBLOCK);
+    Serial.attach(mcu);
+
+    setup();
+    sim.xtal = Si.getXtalCurrent();
+    if (!pcExpect("0:> ")) fail("no prompt");
+
+    printf("== text mode ==\n");
+    textMode(7000000, 10, 2000);
+
+    printf("== binary mode ==\n");
+    binaryMode("binary 'F'", 7000000, 10, 20000, 1);
+    binaryMode("binary 'F' 1 kHz steps", 7000000, 1000, 20000, 1);
+    binaryCommands();
+    binaryMode("binary 'L' x3", 7000000, 10, 10000, 3);
+
+    printf("%s: %d failures\n", failures ? "FAIL" : "PASS", failures);
+    return failures ? 1 : 0;
+}
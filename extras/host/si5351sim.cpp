@@ -0,0 +1,225 @@
+/*
+ * si5351mcu - Si5351 library for Arduino MCU tuned for size and click-less
+ *
+ * Host (Linux) register model of the Si5351, see si5351sim.h
+ *
+ * Register layout from the Silicon Labs AN619.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include "si5351sim.h"
+
+Si5351sim::Si5351sim(uint32_t nxtal, uint8_t naddr) {
+    xtal = nxtal;
+    address = naddr;
+    powerOn();
+}
+
+/*****************************************************************************
+ * Power on state: all registers clear but the CLKx control ones, all the
+ * outputs start powered down.
+ ****************************************************************************/
+void Si5351sim::powerOn(void) {
+    memset(reg, 0, sizeof(reg));
+    for (uint8_t i = 16; i < 24; i++) reg[i] = 0x80;
+    ptr = 0;
+    lockMicros = 0;
+    lockAt[0] = lockAt[1] = micros();
+    for (uint8_t i = 0; i < 8; i++) {
+        phaseOff[i] = 0;
+        phaseOk[i] = true;
+    }
+    clearCounters();
+}
+
+void Si5351sim::clearCounters(void) {
+    transactions = writes = reads = 0;
+    bytesWritten = bytesRead = bits = 0;
+    resets = pllResets[0] = pllResets[1] = 0;
+}
+
+/*****************************************************************************
+ * Time on the wire, each byte is 8 bits + ACK, plus start & stop
+ ****************************************************************************/
+uint32_t Si5351sim::busMicros(void) const {
+    return (uint32_t)(((uint64_t)bits * 1000000L) / SIM_I2C_HZ);
+}
+
+/*****************************************************************************
+ * A write transaction, the first byte is the register pointer, the rest
+ * are data written with auto increment of the pointer.
+ ****************************************************************************/
+uint8_t Si5351sim::i2cWrite(const uint8_t *buf, uint8_t len) {
+    transactions++;
+    writes++;
+    bytesWritten += len;
+    bits += 2 + 9 * (1 + len);
+
+    if (len == 0) return 0;
+    ptr = buf[0];
+
+    for (uint8_t i = 1; i < len; i++) {
+        uint8_t r = ptr++;
+
+        // sticky bits: a 0 clears them, a 1 does nothing
+        if (r == 1) {
+            reg[r] &= buf[i];
+            continue;
+        }
+
+        // a new multisynth or PLL source: the phase is lost until a reset
+        if (r >= 42 && r < 90 && reg[r] != buf[i]) phaseOk[(r - 42) / 8] = false;
+        if (r >= 16 && r < 24 && ((reg[r] ^ buf[i]) & 0x20)) phaseOk[r - 16] = false;
+
+        reg[r] = buf[i];
+
+        // PLL soft reset, self clearing; the PLL is out of lock a while
+        // and the outputs on it are aligned to their phase offsets
+        if (r == 177) {
+            if (buf[i] & 0xA0) resets++;
+            for (uint8_t p = 0; p < 2; p++) {
+                if (!(buf[i] & (p ? 0x80 : 0x20))) continue;
+                pllResets[p]++;
+                lockAt[p] = micros() + lockMicros;
+                if (lockMicros) reg[1] |= p ? 0x40 : 0x20;
+                for (uint8_t c = 0; c < 8; c++) {
+                    if (clkPll(c) != p) continue;
+                    phaseOff[c] = c < 6 ? reg[165 + c] & 0x7F : 0;
+                    phaseOk[c] = true;
+                }
+            }
+            reg[r] = 0;
+        }
+    }
+
+    return 0;
+}
+
+/*****************************************************************************
+ * A read transaction from the current register pointer
+ ****************************************************************************/
+uint8_t Si5351sim::i2cRead(uint8_t *buf, uint8_t len) {
+    transactions++;
+    reads++;
+    bytesRead += len;
+    bits += 2 + 9 * (1 + len);
+
+    // the status: out of lock until lockAt
+    reg[0] &= ~0x60;
+    for (uint8_t p = 0; p < 2; p++) {
+        if ((int32_t)(micros() - lockAt[p]) < 0) reg[0] |= p ? 0x40 : 0x20;
+    }
+
+    for (uint8_t i = 0; i < len; i++) buf[i] = reg[ptr++];
+
+    return len;
+}
+
+/*****************************************************************************
+ * Decoders
+ ****************************************************************************/
+
+// generic P1/P2/P3 layout of the PLL and MS0..MS5 banks: (P1 + 512 + P2/P3) / 128
+static double ratio(const uint8_t *r) {
+    uint32_t P1, P2, P3;
+
+    P3 = ((uint32_t)(r[5] & 0xF0) << 12) | ((uint32_t)r[0] << 8) | r[1];
+    P1 = ((uint32_t)(r[2] & 0x03) << 16) | ((uint32_t)r[3] << 8) | r[4];
+    P2 = ((uint32_t)(r[5] & 0x0F) << 16) | ((uint32_t)r[6] << 8) | r[7];
+
+    if (P3 == 0) return 0;
+
+    return (P1 + 512 + (long double)P2 / P3) / 128.0L;
+}
+
+double Si5351sim::pllRatio(uint8_t pll) const {
+    return ratio(&reg[26 + 8 * (pll & 1)]);
+}
+
+double Si5351sim::pllFreq(uint8_t pll) const {
+    return (long double)xtal * pllRatio(pll);
+}
+
+double Si5351sim::msDivider(uint8_t clk) const {
+    if (clk >= 6) return reg[90 + clk - 6];
+
+    const uint8_t *r = &reg[42 + 8 * clk];
+    if ((r[2] & 0x0C) == 0x0C) return 4;
+    return ratio(r);
+}
+
+uint8_t Si5351sim::rDivider(uint8_t clk) const {
+    if (clk == 6) return 1 << (reg[92] & 0x07);
+    if (clk == 7) return 1 << ((reg[92] >> 4) & 0x07);
+
+    return 1 << ((reg[44 + 8 * clk] >> 4) & 0x07);
+}
+
+uint8_t Si5351sim::clkPll(uint8_t clk) const {
+    return (reg[16 + clk] >> 5) & 1;
+}
+
+bool Si5351sim::clkPowered(uint8_t clk) const {
+    return !(reg[16 + clk] & 0x80) && !(reg[3] & (1 << clk));
+}
+
+bool Si5351sim::clkInteger(uint8_t clk) const {
+    return reg[16 + clk] & 0x40;
+}
+
+uint8_t Si5351sim::clkDrive(uint8_t clk) const {
+    return reg[16 + clk] & 0x03;
+}
+
+bool Si5351sim::sscEnabled(void) const {
+    return reg[149] & 0x80;
+}
+
+double Si5351sim::clkVco(uint8_t clk) const {
+    return pllFreq(clkPll(clk));
+}
+
+double Si5351sim::outFreq(uint8_t clk) const {
+    // only the "MSx as source" is modeled
+    if (!clkPowered(clk) || ((reg[16 + clk] >> 2) & 3) != 3) return 0;
+
+    double div = msDivider(clk);
+    if (div <= 0) return 0;
+
+    return (long double)clkVco(clk) / div / rDivider(clk);
+}
+
+void Si5351sim::print(FILE *f) const {
+    fprintf(f, "PLLA %.3f Hz (x%.9f)  PLLB %.3f Hz (x%.9f)%s\n",
+        pllFreq(0), pllRatio(0), pllFreq(1), pllRatio(1),
+        sscEnabled() ? "  SSC ON" : "");
+
+    for (uint8_t clk = 0; clk < 8; clk++) {
+        fprintf(f, "CLK%d: %s PLL%c MS=%.6f R=%d %s drive=%d freq=%.3f Hz\n",
+            clk, clkPowered(clk) ? "on " : "off", 'A' + clkPll(clk),
+            msDivider(clk), rDivider(clk), clkInteger(clk) ? "int " : "frac",
+            clkDrive(clk), outFreq(clk));
+    }
+}
+
+double Si5351sim::clkPhase(uint8_t clk) const {
+    double div = msDivider(clk) * rDivider(clk);
+
+    if (!phaseOk[clk] || div == 0) return NAN;
+
+    // the offset is in quarters of the VCO period
+    return 360.0 * phaseOff[clk] / (4 * div);
+}
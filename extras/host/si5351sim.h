@@ -0,0 +1,114 @@
+/*
+ * si5351mcu - Si5351 library for Arduino MCU tuned for size and click-less
+ *
+ * Host (Linux) register model of the Si5351, it sits behind the mock Wire
+ * library and keeps a copy of the 256 registers of the chip.
+ *
+ * It decodes the same registers the lib programs:
+ *
+ * - 16..23  CLKx control (power down, int mode, PLL source, drive)
+ * - 26..41  PLLA & PLLB feedback multisynth (MSNA/MSNB)
+ * - 42..89  MS0..MS5 output multisynths (with the R divider & DIVBY4)
+ * - 90..92  MS6 & MS7 integer dividers and their R dividers
+ * - 149     Spread spectrum enable
+ * - 177     PLL soft reset
+ *
+ * And with that it computes the output frequency the chip would produce
+ * from a given xtal, and counts the bus traffic the lib generates.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SI5351SIM_H
+#define SI5351SIM_H
+
+#include "Arduino.h"
+
+// the I2C bus speed used for the bus time estimations
+#define SIM_I2C_HZ 100000L
+
+class Si5351sim {
+    public:
+        // I2C address, xtal frequency of the simulated board
+        uint8_t address;
+        uint32_t xtal;
+
+        // the chip registers
+        uint8_t reg[256];
+
+        // bus traffic counters
+        uint32_t transactions;      // write + read transactions
+        uint32_t writes;            // write transactions
+        uint32_t reads;             // read transactions
+        uint32_t bytesWritten;      // bytes after the address (reg pointer + data)
+        uint32_t bytesRead;         // data bytes read back
+        uint32_t bits;              // bits on the wire, address & start/stop included
+        uint32_t resets;            // writes to reg 177 with any PLL reset bit set
+        uint32_t pllResets[2];      // per PLL (A, B)
+
+        // PLL lock: time to lock after a PLL reset (uS, 0 = at once), the
+        // status (reg 0) shows LOL_x until then and it's latched on the
+        // sticky bits (reg 1), cleared by writing a 0 to them
+        uint32_t lockMicros;
+
+    private:
+        uint8_t ptr;                // register pointer (auto increment)
+        uint32_t lockAt[2];         // micros() when each PLL locks
+
+        // the phase offsets (reg 165+) are taken on a PLL reset, and the
+        // phase is lost if the multisynth or its PLL changes after it
+        uint8_t phaseOff[8];
+        bool    phaseOk[8];
+
+    public:
+        Si5351sim(uint32_t xtal = 27000000L, uint8_t address = 0x60);
+
+        // power on state & counters clear
+        void powerOn(void);
+        void clearCounters(void);
+
+        // estimated time on the wire for the counted traffic (uS)
+        uint32_t busMicros(void) const;
+
+        // called by the mock Wire: returns the Wire.endTransmission() code
+        uint8_t i2cWrite(const uint8_t *buf, uint8_t len);
+        uint8_t i2cRead(uint8_t *buf, uint8_t len);
+
+        // decoders, PLL 0 = A, 1 = B; clk = 0..7
+        double pllRatio(uint8_t pll) const;
+        double pllFreq(uint8_t pll) const;
+        double msDivider(uint8_t clk) const;     // multisynth divider (no R)
+        uint8_t rDivider(uint8_t clk) const;     // 1..128
+        uint8_t clkPll(uint8_t clk) const;       // PLL source: 0 = A, 1 = B
+        bool    clkPowered(uint8_t clk) const;   // CLKx_PDN low and not OEB
+        bool    clkInteger(uint8_t clk) const;   // MSx_INT set
+        uint8_t clkDrive(uint8_t clk) const;     // 0..3 (2/4/6/8 mA)
+        bool    sscEnabled(void) const;
+
+        // the frequency on the CLKx pin in Hz, 0 if it's off
+        double outFreq(uint8_t clk) const;
+
+        // VCO of the PLL feeding the CLKx
+        double clkVco(uint8_t clk) const;
+
+        // the phase of CLKx (degrees of its period) from the offset taken
+        // on the last reset of its PLL; NAN if the multisynth or the PLL
+        // source changed after that reset (the phase is not known)
+        double clkPhase(uint8_t clk) const;
+
+        // dump of the decoded state, for debug
+        void print(FILE *f = stdout) const;
+};
+
+#endif // SI5351SIM_H
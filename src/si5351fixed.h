@@ -0,0 +1,323 @@
+/*
+ * si5351mcu - Si5351 library for Arduino MCU tuned for size and click-less
+ *
+ * Copyright (C) 2017 Pavel Milanes <pavelmc@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/****************************************************************************
+ * Compile time specialised driver
+ *
+ * The tuning of Si5351mcu::setFreq() (same registers, same divider
+ * planner) for the ones that don't change the xtal at runtime: the xtal,
+ * the max VCO and the number of outputs are template parameters, so the
+ * compiler folds all it can:
+ *
+ * - "c" (xtal >> 5), the PLL P3 and the constant bytes of the PLL bank
+ * - fvco / xtal and 128 * b / c are a multiply & shift by a reciprocal
+ *   computed at compile time plus a fix up, no 32 bit divisions there
+ * - the R divider is picked comparing the freq with compile time limits
+ * - the divider planner window is kept as two freqs, no division to know
+ *   if the output divider can be kept
+ *
+ * The only division left on setFreq() is the one on a new output divider.
+ *
+ * And it strips all the rest: no correction, shadow, batch, async, PLL
+ * allocator, hopping, readback or stats. CLK0 runs on PLLA and the other
+ * outputs on PLLB (the v0.7 rule: the last one set or enabled owns it, the
+ * others on PLLB are turned off); it just remembers the PLL banks sent to start the write on the first byte that
+ * changed (always up to the end of the bank).
+ *
+ * Usage, 25 MHz xtal, default VCO & 3 outputs:
+ *
+ *   #include "si5351fixed.h"
+ *
+ *   Si5351fixed<25000000L> Si;
+ *
+ *   Si.init();
+ *   Si.setFreq(0, 7100000);
+ *   Si.enable(0);
+ *
+ * It's header only, nothing of the Si5351mcu class is linked if you don't
+ * use it. The xtal must be the real one (the corrected, if you measured
+ * it) and below 33.5 MHz; the max VCO is SI_VCO_MAX by default (that is
+ * SI_OVERCLOCK if defined before the include).
+ ****************************************************************************/
+
+#ifndef SI5351FIXED_H
+#define SI5351FIXED_H
+
+// the constants & register layout are shared with the full lib
+#include "si5351mcu.h"
+
+// x / d as (x >> pre) * m >> s, m the floor of 2^(pre + s) / d: the
+// biggest s with no overflow on the product for x up to max; the result is
+// never over and is short by one at most (fixed up on the run)
+constexpr uint8_t si_recshift(uint32_t max, uint32_t d, uint8_t pre, uint8_t s = 1) {
+    return (uint64_t)(max >> pre) * ((1ULL << (pre + s)) / d) < (1ULL << 32) ?
+        si_recshift(max, d, pre, s + 1) : s - 1;
+}
+
+constexpr uint32_t si_recmul(uint32_t max, uint32_t d, uint8_t pre) {
+    return (1ULL << (pre + si_recshift(max, d, pre))) / d;
+}
+
+template <uint32_t XTAL = 27000000L, uint32_t VCO_MAX = SI_VCO_MAX, uint8_t CHANNELS = 3>
+class Si5351fixed {
+    static_assert(XTAL >= 10000000L && (XTAL >> 5) < 1048576L, "Si5351fixed: xtal out of range");
+    static_assert(VCO_MAX > SI_VCO_MIN && VCO_MAX < 0x80000000UL, "Si5351fixed: VCO out of range");
+    static_assert(CHANNELS >= 1 && CHANNELS <= 6, "Si5351fixed: 1 to 6 outputs");
+
+    // "c" of the PLL a + b / c, the xtal scaled to fit the 20 bits
+    static constexpr uint32_t C = XTAL >> 5;
+
+    // fvco / xtal as (fvco >> 12) * QM >> QS
+    static constexpr uint8_t  QS = si_recshift(VCO_MAX, XTAL, 12);
+    static constexpr uint32_t QM = si_recmul(VCO_MAX, XTAL, 12);
+
+    // 128 * b / c as ((128 * b) >> 7) * FM >> FS, that is b * FM >> FS
+    // (b <= c)
+    static constexpr uint8_t  FS = si_recshift(C << 7, C, 7);
+    static constexpr uint32_t FM = si_recmul(C << 7, C, 7);
+
+    // the highest freq that needs R = 2^s, the divider would be over 900
+    static constexpr uint32_t rLimit(uint8_t s) {
+        return (VCO_MAX / 901) >> s;
+    }
+
+    TwoWire *bus;
+    uint8_t addr;
+
+    // output divider & R (the register bits) in use, and the freq window
+    // where they keep the VCO in range
+    uint16_t omsynth[CHANNELS];
+    uint8_t  o_Rdiv[CHANNELS];
+    uint32_t o_lo[CHANNELS], o_hi[CHANNELS];
+
+    // the PLL banks on the chip, to send just the bytes that change
+    uint8_t pllimg[2][8];
+    bool    pllok[2];
+
+    uint8_t clkpower[CHANNELS];
+
+    /*************************************************************************
+     * The PLL bank for a VCO freq, the same values of Si5351mcu::pllMath()
+     ************************************************************************/
+    static void pllBank(uint32_t fvco, uint8_t *regs) {
+        uint32_t a, b, f, rem, P1, P2;
+
+        // a = fvco / xtal & the remainder, the reciprocal is short by one
+        // at most
+        a = ((fvco >> 12) * QM) >> QS;
+        rem = fvco - a * XTAL;
+        while (rem >= XTAL) {
+            rem -= XTAL;
+            a++;
+        }
+
+        // f = 128 * b / c, the same
+        b = rem >> 5;
+        f = (b * FM) >> FS;
+        P2 = 128 * b - f * C;
+        while (P2 >= C) {
+            P2 -= C;
+            f++;
+        }
+        P1 = 128 * a + f - 512;
+
+        // C is a constant, so are regs[0], regs[1] & half of regs[5]
+        regs[0] = (C & 0xFF00) >> 8;
+        regs[1] = C & 0xFF;
+        regs[2] = (P1 & 0x030000L) >> 16;
+        regs[3] = (P1 & 0xFF00) >> 8;
+        regs[4] = P1 & 0xFF;
+        regs[5] = ((C & 0x0F0000L) >> 12) | ((P2 & 0x0F0000) >> 16);
+        regs[6] = (P2 & 0xFF00) >> 8;
+        regs[7] = P2 & 0xFF;
+    }
+
+    void i2cWriteBurst(uint8_t reg, const uint8_t *data, uint8_t n) {
+        bus->beginTransmission(addr);
+        bus->write(reg);
+        bus->write(data, n);
+        bus->endTransmission();
+    }
+
+    void i2cWrite(uint8_t reg, uint8_t value) {
+        i2cWriteBurst(reg, &value, 1);
+    }
+
+    uint8_t clkCtrl(uint8_t clk) {
+        return (clk ? SICLK12_R : SICLK0_R) + clkpower[clk];
+    }
+
+    // CLK1 and up share PLLB: turn off the others, they would be on a
+    // wrong freq
+    void pllbOwner(uint8_t clk) {
+        for (uint8_t i = 1; i < CHANNELS; i++) {
+            if (i != clk && clkOn[i]) disable(i);
+        }
+    }
+
+  public:
+    // var to check the clock state
+    bool clkOn[CHANNELS];
+
+    // the I2C bus & address of the chip, by default Wire & SIADDR
+    Si5351fixed(TwoWire &nbus = Wire, uint8_t naddr = SIADDR) : bus(&nbus), addr(naddr) {}
+
+    /*************************************************************************
+     * Start the I2C, spread spectrum & all the outputs off; the dividers
+     * and PLLs are written on the first setFreq()
+     ************************************************************************/
+    void init(void) {
+        int16_t v = -1;
+
+        memset(omsynth, 0, sizeof(omsynth));
+        memset(clkpower, 0, sizeof(clkpower));
+        pllok[0] = pllok[1] = false;
+
+        bus->begin();
+
+        // spread spectrum off
+        bus->beginTransmission(addr);
+        bus->write(149);
+        if (!bus->endTransmission() && bus->requestFrom((int)addr, 1) == 1) v = bus->read();
+        if (v > 0 && (v & 0x80)) i2cWrite(149, v & ~0x80);
+
+        off();
+    }
+
+    /*************************************************************************
+     * Set CLKx to freq (Hz), false if out of range. The output divider is
+     * kept while the VCO is in range with it, a new one is picked with the
+     * rule of Si5351mcu::planDiv(): going up (over the window) the smallest
+     * one, the VCO at the bottom; going down or the first time the biggest
+     * one, the VCO on top. Only then there is a reset.
+     ************************************************************************/
+    bool setFreq(uint8_t clk, uint32_t freq) {
+        uint8_t regs[8], p = clk ? 1 : 0, s, i;
+        uint32_t d = 0, step;
+
+        if (clk >= CHANNELS || !freq) return false;
+        if (clk) pllbOwner(clk);
+
+        // the actual dividers are good: no division at all
+        if (!omsynth[clk] || freq < o_lo[clk] || freq > o_hi[clk]) {
+            // going up: the smallest even divider (and R) with the VCO over
+            // the minimum
+            if (omsynth[clk] && freq > o_hi[clk]) {
+                step = (SI_VCO_MIN + freq - 1) / freq;
+                for (s = 0; s < 8; s++) {
+                    d = (step + (1UL << s) - 1) >> s;
+                    d += d & 1;
+                    if (d < 4) d = 4;
+                    if (d <= 900) break;
+                }
+                if (s == 8 || (d << s) * freq > VCO_MAX) d = 0;
+            }
+
+            // going down, the first time or no luck: R against constant
+            // limits, the biggest divider
+            if (!d) {
+                for (s = 0; s < 7 && freq <= rLimit(s); s++);
+                d = VCO_MAX / (freq << s);
+                d &= ~1UL;
+                if (d < 4 || d > 900) return false;
+            }
+
+            // the new window, the dividers are written below
+            step = d << s;
+            o_lo[clk] = (SI_VCO_MIN + step - 1) / step;
+            o_hi[clk] = VCO_MAX / step;
+            omsynth[clk] = 0;
+            o_Rdiv[clk] = s << 4;
+            d |= 0x8000;
+        } else {
+            d = omsynth[clk];
+        }
+
+        pllBank(((d & 0x7FFF) << (o_Rdiv[clk] >> 4)) * freq, regs);
+
+        if (d & 0x8000) {
+            // all the PLL bank, the output divider & the reset of the PLL
+            uint8_t ms[8] = { 0, 1, 0, 0, 0, 0, 0, 0 };
+            uint32_t P1 = 128 * (d & 0x7FFF) - 512;
+
+            omsynth[clk] = d & 0x7FFF;
+            ms[2] = ((P1 & 0x030000L) >> 16) | o_Rdiv[clk];
+            if (omsynth[clk] == 4) ms[2] |= 0x0C;
+            ms[3] = (P1 & 0xFF00) >> 8;
+            ms[4] = P1 & 0xFF;
+
+            memcpy(pllimg[p], regs, 8);
+            pllok[p] = true;
+            i2cWriteBurst(26 + 8 * p, regs, 8);
+            i2cWriteBurst(42 + 8 * clk, ms, 8);
+            i2cWrite(177, p ? 0x80 : 0x20);
+            return true;
+        }
+
+        // the PLL bytes from the first that changed to the end of the bank,
+        // the chip takes the new values on the write of the last one
+        i = 0;
+        if (pllok[p]) {
+            while (i < 8 && regs[i] == pllimg[p][i]) i++;
+        }
+        if (i < 8) {
+            memcpy(pllimg[p] + i, regs + i, 8 - i);
+            pllok[p] = true;
+            i2cWriteBurst(26 + 8 * p + i, regs + i, 8 - i);
+        }
+
+        return true;
+    }
+
+    // enable CLKx output, the other PLLB ones go off
+    void enable(uint8_t clk) {
+        if (clk) pllbOwner(clk);
+        i2cWrite(16 + clk, clkCtrl(clk));
+        clkOn[clk] = 1;
+    }
+
+    // disable CLKx output
+    void disable(uint8_t clk) {
+        i2cWrite(16 + clk, 0x80);
+        clkOn[clk] = 0;
+    }
+
+    // disable all outputs, in a single burst
+    void off(void) {
+        uint8_t regs[CHANNELS];
+
+        memset(regs, 0x80, sizeof(regs));
+        memset(clkOn, 0, sizeof(clkOn));
+        i2cWriteBurst(16, regs, CHANNELS);
+    }
+
+    // set power output to a specific clk, SIOUT_2mA to SIOUT_8mA
+    void setPower(uint8_t clk, uint8_t power) {
+        clkpower[clk] = power;
+        enable(clk);
+    }
+
+    // reset both PLLs
+    void reset(void) {
+        i2cWrite(177, 0xA0);
+    }
+};
+
+#endif
@@ -33,6 +33,57 @@
     #include "Wire.h"
 #endif
 
+// bit flags handling for the shadow registers (ok/dirty)
+#define SI_BIT(f, i)    (f[(i) >> 3] & (1 << ((i) & 7)))
+#define SI_SET(f, i)    f[(i) >> 3] |= 1 << ((i) & 7)
+#define SI_CLR(f, i)    f[(i) >> 3] &= ~(1 << ((i) & 7))
+
+// a shadow register we know the value: the chip has it or it's pending
+#define SI_KNOWN(i)     (SI_BIT(shadow_ok, i) || SI_BIT(shadow_dirty, i))
+
+// the hot path counters, nothing if SI_STATS is not defined
+#ifdef SI_STATS
+    #define SI_COUNT(what, n)   stats.what += (n)
+#else
+    #define SI_COUNT(what, n)
+#endif
+
+// and the time on the bus, SI_STATS_TIME: a start & the count
+#ifdef SI_STATS_TIME
+    #define SI_TIME_START()     uint32_t t0 = micros()
+    #define SI_TIME_COUNT()     stats.busMicros += micros() - t0
+#else
+    #define SI_TIME_START()
+    #define SI_TIME_COUNT()
+#endif
+
+// all the instances, for pumpAll()
+Si5351mcu *Si5351mcu::chain = NULL;
+
+/*****************************************************************************
+ * Constructor, the I2C bus & address of the chip; several chips on the same
+ * or other buses are just several instances
+ *****************************************************************************/
+Si5351mcu::Si5351mcu(TwoWire &nbus, uint8_t naddr, uint8_t nchannels) {
+    bus = &nbus;
+    addr = naddr;
+
+    // the outputs, and the shadow bytes up to the last multisynth we use
+    channels = nchannels > SI_CHANNELS_MAX ? SI_CHANNELS_MAX : nchannels;
+    shadowSize = channels > 6 ? SI_SHADOW_SIZE : 42 + 8 * channels - SI_SHADOW_FIRST;
+
+    // keep track of all the instances
+    next = chain;
+    chain = this;
+}
+
+Si5351mcu::~Si5351mcu(void) {
+    Si5351mcu **p = &chain;
+
+    while (*p && *p != this) p = &(*p)->next;
+    if (*p) *p = next;
+}
+
 /*****************************************************************************
  * This is the default init procedure, it set the Si5351 with this params:
  * XTAL 27.000 Mhz
@@ -48,20 +99,206 @@
  * and has the duty of init the I2C protocol handshake
  *****************************************************************************/
  void Si5351mcu::init(uint32_t nxtal) {
+    initState(nxtal);
+
+    // shut off the spread spectrum by default, DWaite contibuted code
+    sscOff();
+
+    // power off all the outputs, in a single burst
+    begin();
+    off();
+    commit();
+}
+
+
+/*****************************************************************************
+ * Warm start: the MCU rebooted (watchdog, brown-out...) but the chip kept
+ * running; instead of dropping all the outputs we read the chip registers
+ * and rebuild our state from them, nothing is written if the chip is fine.
+ *
+ * The shadow is loaded from the chip too, so setting the same freqs again
+ * after it sends nothing to the bus: no dropouts, no resets.
+ *
+ * If the chip is not programmed (in its power on state), has all the outputs
+ * off or has something we don't understand it's a plain (cold) init(),
+ * returns false in that case.
+ *****************************************************************************/
+bool Si5351mcu::initWarm(void) {
+    // init with the default freq
+    return initWarm(int_xtal);
+}
+
+bool Si5351mcu::initWarm(uint32_t nxtal) {
+    initState(nxtal);
+
+    if (!warmState()) {
+        init(nxtal);
+        return false;
+    }
+
+    sscOff();
+    return true;
+}
+
+
+/*****************************************************************************
+ * set the xtal & forget all we know about the chip, and start the I2C
+ *****************************************************************************/
+void Si5351mcu::initState(uint32_t nxtal) {
     // set the new base xtal freq
     base_xtal = int_xtal = nxtal;
 
+    // we don't know what the chip has inside, invalidate the shadow
+    memset(shadow_ok, 0, sizeof(shadow_ok));
+    memset(shadow_dirty, 0, sizeof(shadow_dirty));
+    batch = dirty = failed = false;
+    reset_pending = 0;
+
+    // and the fast path & divider planner data, the output dividers will be
+    // written on the first setFreq()
+    memset(o_freq, 0, sizeof(o_freq));
+    memset(omsynth, 0, sizeof(omsynth));
+    memset(o_Rdiv, 0, sizeof(o_Rdiv));
+    memset(clkfreq, 0, sizeof(clkfreq));
+
+    // default PLL for each output, see the header, and no one in use
+    clkpll = 0xFE;
+    clkused = clkfrac = 0;
+    pllowner[0] = pllowner[1] = 0xFF;
+    pllvco[0] = pllvco[1] = 0;
+    r92 = 0;
+    quadI = quadQ = 0xFF;
+    quadN = 0;
+    hopclk = 0xFF;
+
     // start I2C (wire) procedures
-    Wire.begin();
+    bus->begin();
+}
 
-    // shut off the spread spectrum by default, DWaite contibuted code  
-    uint8_t regval;
-    regval = i2cRead(149);
-    regval &= ~0x80;  // set bit 7 LOW to turn OFF spread spectrum mode
-    i2cWrite(149, regval);
 
-    // power off all the outputs
-    off();
+/*****************************************************************************
+ * spread spectrum off, just a read if it's off already
+ *****************************************************************************/
+void Si5351mcu::sscOff(void) {
+    int16_t regval = i2cRead(149);
+
+    // set bit 7 LOW to turn OFF spread spectrum mode; a failed read is -1,
+    // nothing to write from it
+    if (regval > 0 && (regval & 0x80)) i2cWrite(149, regval & ~0x80);
+}
+
+
+/*****************************************************************************
+ * Load the shadow from the chip and rebuild the state from it, for the
+ * warm start; false if the chip is not programmed or not readable.
+ *
+ * An output powered on and fed by its multisynth is in use: the first one
+ * on each PLL with an even integer divider owns it (it's what setFreq()
+ * does) and the rest follow. The freqs are the nearest Hz to what the chip
+ * makes with our xtal, the VCO of the owners is taken as freq * divider so
+ * a setFreq() to the same freq finds all the registers in place.
+ *****************************************************************************/
+bool Si5351mcu::warmState(void) {
+    uint8_t clk, p, ctrl, R, m = 0;
+    uint32_t vco[2], div[SI_CHANNELS_MAX], rdiv;
+    uint64_t num;
+    Si5351div d[2 + SI_CHANNELS_MAX];
+
+    // SYS_INIT: the chip is still loading its defaults
+    p = i2cRead(0);
+    if (p & 0x80) return false;
+
+    if (i2cReadBurst(SI_SHADOW_FIRST, shadow, shadowSize) != shadowSize) {
+        return false;
+    }
+
+    // the PLLs, rounded down to the Hz
+    for (p = 0; p < 2; p++) {
+        unBank(&shadow[26 + 8 * p - SI_SHADOW_FIRST], d[p]);
+        vco[p] = d[p].P3 ? mulDiv((uint64_t)d[p].P3 * (d[p].P1 + 512) + d[p].P2,
+                                  int_xtal, 128UL * d[p].P3) : 0;
+    }
+
+    // the outputs in use, check they make sense before we touch anything
+    for (clk = 0; clk < channels; clk++) {
+        ctrl = shadow[16 + clk - SI_SHADOW_FIRST];
+        if ((ctrl & 0x80) || (ctrl & 0x0C) != 0x0C) continue;
+
+        if (clk < 6) {
+            unBank(&shadow[42 + 8 * clk - SI_SHADOW_FIRST], d[2 + clk]);
+            if ((shadow[44 + 8 * clk - SI_SHADOW_FIRST] & 0x0C) == 0x0C) {
+                d[2 + clk].P1 = d[2 + clk].P2 = 0;
+                d[2 + clk].P3 = 1;
+            }
+        } else {
+            R = shadow[90 + clk - 6 - SI_SHADOW_FIRST];
+            d[2 + clk].P1 = 128UL * R - 512;
+            d[2 + clk].P2 = 0;
+            d[2 + clk].P3 = R < 4 ? 0 : 1;
+        }
+
+        if (!vco[(ctrl >> 5) & 1] || !d[2 + clk].P3) return false;
+        m |= 1 << clk;
+    }
+
+    // nothing running, nothing to keep
+    if (!m) return false;
+
+    // all good, the chip has what the shadow says (the bytes past the
+    // outputs we have are never used)
+    memset(shadow_ok, 0xFF, sizeof(shadow_ok));
+    if (channels > 6) r92 = shadow[92 - SI_SHADOW_FIRST];
+
+    for (clk = 0; clk < channels; clk++) {
+        ctrl = shadow[16 + clk - SI_SHADOW_FIRST];
+        clkOn[clk] = (m >> clk) & 1;
+        if (!clkOn[clk]) continue;
+
+        p = (ctrl >> 5) & 1;
+        clkpower[clk] = ctrl & 0x03;
+        clkpll = (clkpll & ~(1 << clk)) | (p << clk);
+        clkused |= 1 << clk;
+
+        // R bits as in the MSx bank
+        if (clk < 6) {
+            R = shadow[44 + 8 * clk - SI_SHADOW_FIRST] & 0x70;
+        } else {
+            R = clk == 6 ? (r92 & 0x07) << 4 : r92 & 0x70;
+        }
+        o_Rdiv[clk] = R;
+
+        // even integer divider: it can own the PLL
+        num = (uint64_t)d[2 + clk].P3 * (d[2 + clk].P1 + 512) + d[2 + clk].P2;
+        div[clk] = 0;
+        if (num % (128UL * d[2 + clk].P3) == 0) div[clk] = num / (128UL * d[2 + clk].P3);
+        if (div[clk] & 1) div[clk] = 0;
+        if (clk < 6 && !(ctrl & 0x40)) {
+            clkfrac |= 1 << clk;
+            div[clk] = 0;
+        }
+
+        if (div[clk] && pllowner[p] == 0xFF) {
+            pllowner[p] = clk;
+            omsynth[clk] = div[clk];
+            rdiv = div[clk] << (R >> 4);
+            clkfreq[clk] = (vco[p] + rdiv / 2) / rdiv;
+            pllvco[p] = clkfreq[clk] * rdiv;
+        }
+    }
+
+    // the followers, from the VCO of the owner (or the one read if none)
+    for (clk = 0; clk < channels; clk++) {
+        if (!((m >> clk) & 1) || clkfreq[clk]) continue;
+
+        p = (clkpll >> clk) & 1;
+        if (!pllvco[p]) pllvco[p] = vco[p];
+
+        num = (uint64_t)d[2 + clk].P3 * (d[2 + clk].P1 + 512) + d[2 + clk].P2;
+        clkfreq[clk] = (mulDiv(pllvco[p], 256UL * d[2 + clk].P3,
+                               num << (o_Rdiv[clk] >> 4)) + 1) / 2;
+    }
+
+    return true;
 }
 
 
@@ -75,140 +312,137 @@
  * - The lib has a reset programmed [aka: click noise] every time it needs to
  *   change the output divider of a particular MSynth, if you move in big steps
  *   this can lead to an increased rate of click noise per tunning step.
- * - If you move at a pace of a few Hz each time the output divider will
- *   change at a low rate, hence less click noise per tunning step.
+ * - The output divider is kept while the VCO is in range with it, when it
+ *   must change the new one is picked to cover the widest window in the
+ *   direction you are moving (see plan() below)
  * - The output divider moves [change] faster at high frequencies, so at HF the
  *   clikc noise is at the real minimum possible.
  *
  * [See the README.md file for other details]
  ****************************************************************************/
-void Si5351mcu::setFreq(uint8_t clk, uint32_t freq) {
-    uint8_t a, R = 1, pll_stride = 0, msyn_stride = 0;
-    uint32_t b, c, f, fvco, outdivider;
-    uint32_t MSx_P1, MSNx_P1, MSNx_P2, MSNx_P3;
+bool Si5351mcu::setFreq(uint8_t clk, uint32_t freq) {
+    failed = false;
+    return tune(clk, freq, 0, false) && !failed;
+}
 
-    // Overclock option
-    #ifdef SI_OVERCLOCK
-        // user a overclock setting for the VCO, max value in my hardware
-        // was 1.05 to 1.1 GHz, as usual YMMV [See README.md for details]
-        outdivider = SI_OVERCLOCK / freq;
-    #else
-        // normal VCO from the datasheet and AN
-        // With 900 MHz beeing the maximum internal PLL-Frequency
-        outdivider = 900000000 / freq;
-    #endif
+/*****************************************************************************
+ * High precision mode: the freq in milli Hz, the PLL fraction is the best
+ * rational approximation with the full 20 bits of MSNx_P3 (see pllFine()),
+ * not the default c = xtal / 32; errors well below 0.01 Hz.
+ *
+ * It's slower (64 bit math, no fast path) so use it where you need sub Hz
+ * steps (narrow band digital modes, a GPSDO loop). Only for the outputs
+ * that own a PLL, a follower gets the integer Hz.
+ ****************************************************************************/
+bool Si5351mcu::setFreqMilli(uint8_t clk, uint64_t freq) {
+    failed = false;
+    fineMath = pllFine;
+    return tune(clk, freq / 1000, freq % 1000, true) && !failed;
+}
 
-    // use additional Output divider ("R")
-    while (outdivider > 900) {
-        R = R * 2;
-        outdivider = outdivider / 2;
-    }
+/*****************************************************************************
+ * setFreq() & setFreqMilli(): freq in Hz plus milli Hz, fine = the high
+ * precision PLL math
+ ****************************************************************************/
+bool Si5351mcu::tune(uint8_t clk, uint32_t freq, uint16_t milli, bool fine) {
+    uint8_t R, pll, fol, pll_stride = 0;
+    uint32_t c, fvco, outdivider, rem;
+    uint32_t MSNx_P1, MSNx_P2, MSNx_P3;
+    bool own;
 
-    // finds the even divider which delivers the intended Frequency
-    if (outdivider % 2) outdivider--;
+    // no such output, or a freq the divider math can't do (0 is a division
+    // by zero below)
+    if (clk >= channels || freq < SI_FREQ_MIN || freq > SI_FREQ_MAX) return false;
 
-    // Calculate the PLL-Frequency (given the even divider)
-    fvco = outdivider * R * freq;
+    SI_COUNT(calls, 1);
 
-    // Convert the Output Divider to the bit-setting required in register 44
-    switch (R) {
-        case 1:   R = 0; break;
-        case 2:   R = 16; break;
-        case 4:   R = 32; break;
-        case 8:   R = 48; break;
-        case 16:  R = 64; break;
-        case 32:  R = 80; break;
-        case 64:  R = 96; break;
-        case 128: R = 112; break;
-    }
+    // a new freq drops the hop prepared for this clk
+    if (clk == hopclk) hopOff();
 
-    // we have now the integer part of the output msynth
-    // the b & c is fixed below
-    
-    MSx_P1 = 128 * outdivider - 512;
+    // quadrature: Q set on its own ends the pair, and I takes Q with it
+    // (the divider must fit the 7 bits phase offset, see quadrature())
+    if (clk == quadQ) quadOff();
+    if (clk == quadI && freq < (SI_VCO_MIN + 125) / 126) return false;
 
-    // calc the a/b/c for the PLL Msynth
-    /***************************************************************************
-    * We will use integer only on the b/c relation, and will >> 5 (/32) both
-    * to fit it on the 1048 k limit of C and keep the relation
-    * the most accurate possible, this works fine with xtals from
-    * 24 to 28 Mhz.
-    *
-    * This will give errors of about +/- 2 Hz maximum
-    * as per my test and simulations in the worst case, well below the
-    * XTAl ppm error...
-    *
-    * This will free more than 1K of the final eeprom
-    *
-    ****************************************************************************/
-    a = fvco / int_xtal;
-    b = (fvco % int_xtal) >> 5;     // Integer part of the fraction
-                                    // scaled to match "c" limits
-    c = int_xtal >> 5;              // "c" scaled to match it's limits
-                                    // in the register
+    // who drives the VCO? if not this clk: a free PLL or follow one, see
+    // the PLL allocator below
+    pll = (clkpll >> clk) & 1;
+    if (pllowner[pll] != clk) {
+        pll = alloc(clk);
+        if (pll > 1) {
+            clkfine &= ~(1 << clk);
+            return follow(clk, freq);
+        }
+    }
 
-    // f is (128*b)/c to mimic the Floor(128*(b/c)) from the datasheet
-    f = (128 * b) / c;
+    // the other outputs on this PLL will follow the new VCO, check they can
+    // before touching anything
+    fol = following(clk);
+    if (fol) {
+        outdivider = plan(clk, freq, R);
+        fvco = (outdivider << (R >> 4)) * freq;
+        for (uint8_t i = 0; i < channels; i++) {
+            if ((fol & (1 << i)) && !fracMath(i, fvco, i == quadQ ? freq : clkfreq[i], NULL)) return false;
+        }
+    }
 
-    // build the registers to write
-    MSNx_P1 = 128 * a + f - 512;
-    MSNx_P2 = 128 * b - f * c;
+    // all the writes in a single burst if we can
+    own = fol && !batch;
+    if (own) begin();
+
+    // "c" scaled to match it's limits in the register, see below
+    c = int_xtal >> 5;
     MSNx_P3 = c;
 
+    // fast path: same output divider & R, no divisions at all
+    if (!fine && fastPll(clk, freq, MSNx_P1, MSNx_P2)) {
+        outdivider = omsynth[clk];
+        R = o_Rdiv[clk];
+        SI_COUNT(fast, 1);
+    } else {
+        SI_COUNT(full, 1);
+
+        // output divider & R
+        outdivider = plan(clk, freq, R);
+
+        // Calculate the PLL-Frequency (given the even divider)
+        fvco = (outdivider << (R >> 4)) * freq;
+
+        if (fine) {
+            // the milli Hz times the dividers go on the fraction of the VCO
+            fineMath(int_xtal, fvco, (outdivider << (R >> 4)) * milli, MSNx_P1, MSNx_P2, MSNx_P3);
+            o_freq[clk] = 0;
+        } else {
+            // calc the a/b/c for the PLL Msynth
+            rem = pllMath(fvco, MSNx_P1, MSNx_P2);
+
+            // keep it for the fast path on the next call
+            o_freq[clk] = freq;
+            o_rem[clk]  = rem;
+            o_N[clk]    = MSNx_P1 + 512;
+            o_P2[clk]   = MSNx_P2;
+        }
+    }
+
+    // the mode & the milli Hz, for a live correction
+    clkmilli[clk] = milli;
+    if (fine) clkfine |= 1 << clk; else clkfine &= ~(1 << clk);
+
     // PLLs and CLK# registers are allocated with a stride, we handle that with
     // the stride var to make code smaller
-    if (clk > 0 ) pll_stride = 8;
+    if (pll) pll_stride = 8;
 
-    // HEX makes it easier to human read on bit shifts
-    uint8_t reg_bank_26[] = { 
-      (MSNx_P3 & 0xFF00) >> 8,          // Bits [15:8] of MSNx_P3 in register 26
-      MSNx_P3 & 0xFF,
-      (MSNx_P1 & 0x030000L) >> 16,
-      (MSNx_P1 & 0xFF00) >> 8,          // Bits [15:8]  of MSNx_P1 in register 29
-      MSNx_P1 & 0xFF,                   // Bits [7:0]  of MSNx_P1 in register 30
-      ((MSNx_P3 & 0x0F0000L) >> 12) | ((MSNx_P2 & 0x0F0000) >> 16), // Parts of MSNx_P3 and MSNx_P1
-      (MSNx_P2 & 0xFF00) >> 8,          // Bits [15:8]  of MSNx_P2 in register 32
-      MSNx_P2 & 0xFF                    // Bits [7:0]  of MSNx_P2 in register 33
-    };
-
-    // We could do this here - but move it next to the reg_bank_42 write
-    // i2cWriteBurst(26 + pll_stride, reg_bank_26, sizeof(reg_bank_26));
+    uint8_t reg_bank_26[8];
+    pllBank(reg_bank_26, MSNx_P1, MSNx_P2, MSNx_P3);
 
     // Write the output divider msynth only if we need to, in this way we can
     // speed up the frequency changes almost by half the time most of the time
     // and the main goal is to avoid the nasty click noise on freq change
     if (omsynth[clk] != outdivider || o_Rdiv[clk] != R ) {
-      
-        // CLK# registers are exactly 8 * clk# bytes stride from a base register.
-        msyn_stride = clk * 8;
-
         // keep track of the change
         omsynth[clk] = (uint16_t) outdivider;
         o_Rdiv[clk] = R;    // cache it now, before we OR mask up R for special divide by 4
 
-        // See datasheet, special trick when MSx == 4
-        //    MSx_P1 is always 0 if outdivider == 4, from the above equations, so there is 
-        //    no need to set it to 0. ... MSx_P1 = 128 * outdivider - 512;
-        //  
-        //        See para 4.1.3 on the datasheet.
-        // 
-        
-        if ( outdivider == 4 ) {
-          R |= 0x0C;    // bit set OR mask for MSYNTH divide by 4, for reg 44 {3:2]
-        }
-        
-        // HEX makes it easier to human read on bit shifts
-        uint8_t reg_bank_42[] = { 
-          0,                         // Bits [15:8] of MS0_P3 (always 0) in register 42
-          1,                         // Bits [7:0]  of MS0_P3 (always 1) in register 43
-          ((MSx_P1 & 0x030000L ) >> 16) | R,  // Bits [17:16] of MSx_P1 in bits [1:0] and R in [7:4] | [3:2]
-          (MSx_P1 & 0xFF00) >> 8,    // Bits [15:8]  of MSx_P1 in register 45
-          MSx_P1 & 0xFF,             // Bits [7:0]  of MSx_P1 in register 46
-          0,                         // Bits [19:16] of MS0_P2 and MS0_P3 are always 0
-          0,                         // Bits [15:8]  of MS0_P2 are always 0
-          0                          // Bits [7:0]   of MS0_P2 are always 0
-        };
-        
         // Get the two write bursts as close together as possible,
         // to attempt to reduce any more click glitches.  This is   
         // at the expense of only 24 increased bytes compilation size in AVR 328.
@@ -216,7 +450,7 @@ void Si5351mcu::setFreq(uint8_t clk, uint32_t freq) {
         // by not doing calculations between the burst writes.
         
         i2cWriteBurst(26 + pll_stride, reg_bank_26, sizeof(reg_bank_26));
-        i2cWriteBurst(42 + msyn_stride, reg_bank_42, sizeof(reg_bank_42));
+        msWrite(clk, outdivider, R);
 
         // 
         // https://www.silabs.com/documents/public/application-notes/Si5350-Si5351%20FAQ.pdf
@@ -231,164 +465,1976 @@ void Si5351mcu::setFreq(uint8_t clk, uint32_t freq) {
         //      lock to it. Any input frequency changes greater than this amount will not 
         //      necessarily track from the input to the output 
         
-        // must reset the so called "PLL", in fact the output msynth
-        reset();
+        // must reset the so called "PLL", in fact the output msynth; just
+        // the one of this clk, the outputs on the other are not touched
+        resetPll(pll);
 
     }
     else {
           i2cWriteBurst(26 + pll_stride, reg_bank_26, sizeof(reg_bank_26));
     }
 
+    // the last freq, to know the sweep direction; a quadrature Q goes with
+    // its I, now that it's done
+    clkfreq[clk] = freq;
+    if (clk == quadI) clkfreq[quadQ] = freq;
+
+    // the VCO moved? the others on this PLL must follow it
+    fvco = ((uint32_t)outdivider << (R >> 4)) * freq;
+    if (pllvco[pll] != fvco) {
+        pllvco[pll] = fvco;
+        for (uint8_t i = 0; i < channels; i++) {
+            // a quadrature Q with the same N has the same bank already
+            if (i == quadQ && outdivider == quadN) continue;
+            if (fol & (1 << i)) follow(i, clkfreq[i]);
+        }
+    }
+
+    // quadrature: a new divider needs a new phase offset for Q, taken on
+    // the reset (a new divider has one already, on the commit)
+    if (clk == quadI && outdivider != quadN && (fol & (1 << quadQ))) {
+        quadN = outdivider;
+        i2cWrite(165 + quadI, 0);
+        i2cWrite(165 + quadQ, outdivider);
+        resetPll(pll);
+    }
+
+    if (own) commit();
+
+    return true;
 }
 
 
 /*****************************************************************************
- * Reset of the PLLs and multisynths output enable
- *
- * This must be called to soft reset the PLLs and cycle the output of the
- * multisynths: this is the "click" noise source in the RF spectrum.
+ * PLL allocator
  *
- * So it must be avoided at all costs, so this lib just call it at the
- * initialization of the PLLs and when a correction is applied
+ * The chip has just two PLLs for all the outputs, each PLL has an "owner"
+ * output that moves the VCO at will with an even integer output divider
+ * (the lowest jitter and the click free tuning of the lib). The other
+ * outputs set on the same PLL "follow" it: the output divider is set to
+ * give the freq from the VCO the owner picked, integer if possible, else
+ * fractional; if the owner moves the VCO they are updated.
  *
- * If you are concerned with accuracy you can implement a reset every
- * other Mhz to be sure it get exactly on spot.
+ * So the first two outputs you set get a PLL on their own, from there on
+ * they share: set the output you tune the most first. An output set with
+ * disable() frees the PLL it owns.
  ****************************************************************************/
-void Si5351mcu::reset(void) {
-    // This soft-resets PLL A & B (32 + 128) in just one step
-    i2cWrite(177, 0xA0);
+
+// the other outputs in use on the PLL of this clk
+uint8_t Si5351mcu::following(uint8_t clk) {
+    uint8_t m = (clkpll >> clk) & 1 ? clkpll : ~clkpll;
+
+    return clkused & m & ~(1 << clk);
 }
 
+// pick a PLL for this clk: 0/1 to own it, 2 to follow one
+uint8_t Si5351mcu::alloc(uint8_t clk) {
+    uint8_t pll = (clkpll >> clk) & 1;
+
+    // nobody else on our PLL (or holding it for a hop)? take it
+    if (!following(clk) && pllowner[pll] == 0xFF) {
+        pllowner[pll] = clk;
+        clkused |= 1 << clk;
+        return pll;
+    }
+
+    // the other PLL is free? move to it
+    clkpll ^= 1 << clk;
+    if (!following(clk) && pllowner[pll ^ 1] == 0xFF) {
+        pllowner[pll ^ 1] = clk;
+        clkused |= 1 << clk;
+        o_freq[clk] = 0;
+        if (clkOn[clk]) i2cWrite(16 + clk, clkCtrl(clk));
+        return pll ^ 1;
+    }
+    clkpll ^= 1 << clk;
+
+    return 2;
+}
 
 /*****************************************************************************
- * Function to disable all outputs
+ * Set a clk as a follower of a PLL: the output divider for freq from the
+ * actual VCO of the PLL, it can be in the same PLL it was or the other, the
+ * one that give us an integer divider is preferred.
  *
- * The PLL are kept running, just the m-synths are powered off.
- *
- * This allows to keep the chip warm and exactly on freq the next time you
- * enable an output.
+ * Return false if the freq can't be made from any of the VCOs.
  ****************************************************************************/
-void Si5351mcu::off(void) {
-    // This disable all the CLK outputs
-    for (byte i=0; i < SICHANNELS; i++) {
-      disable(i);
+bool Si5351mcu::follow(uint8_t clk, uint32_t freq) {
+    uint8_t regs[8], pll = (clkpll >> clk) & 1, ctrl = clkCtrl(clk);
+    uint8_t fit[2], held = 2;
+
+    // the idle PLL of a prepared hop will move, keep off it
+    if (hopclk != 0xFF) held = (~clkpll >> hopclk) & 1;
+
+    for (uint8_t p = 0; p < 2; p++) {
+        fit[p] = pllvco[p] && p != held ? fracMath(clk, pllvco[p], freq, NULL) : 0;
     }
-}
 
+    // integer on the other, or nothing here: move
+    if (fit[pll ^ 1] > fit[pll]) pll ^= 1;
+    if (!fit[pll]) return false;
+
+    fracMath(clk, pllvco[pll], freq, regs);
+
+    // we are a follower now
+    if (pllowner[0] == clk) pllowner[0] = 0xFF;
+    if (pllowner[1] == clk) pllowner[1] = 0xFF;
+    clkused |= 1 << clk;
+    clkpll = (clkpll & ~(1 << clk)) | (pll << clk);
+    clkfrac = (clkfrac & ~(1 << clk)) | ((fit[pll] == 1) << clk);
+
+    // MS6 & MS7 are integer only, R bits packed in reg 92
+    if (clk >= 6) {
+        ms67(clk, regs[0], regs[1]);
+    } else {
+        i2cWriteBurst(42 + clk * 8, regs, sizeof(regs));
+    }
+
+    // the setFreq() data is not valid for us now
+    omsynth[clk] = 0;
+    o_freq[clk] = 0;
+    clkfreq[clk] = freq;
+
+    // the PLL or integer/fractional mode changed
+    if (clkOn[clk] && clkCtrl(clk) != ctrl) i2cWrite(16 + clk, clkCtrl(clk));
+
+    return true;
+}
 
 /*****************************************************************************
- * Function to set the correction in Hz over the Si5351 XTAL.
+ * The output multisynth for freq from a VCO, the smallest R that gets the
+ * divider in range (8 to 2048 fractional, 4, 6 & 8 to 2048 even integer; 6
+ * to 254 even integer only for MS6 & MS7)
  *
- * This will call a reset of the PLLs and multi-synths so it will produce a
- * click every time it's called
+ * Returns 0 if it can't be done, 1 if the divider is fractional and 2 if
+ * it's an even integer; if regs is not NULL the bank is built there (for
+ * MS6 & MS7 just the divider & the R bits)
  ****************************************************************************/
-void Si5351mcu::correction(int32_t diff) {
-    // apply some corrections to the xtal
-    int_xtal = base_xtal + diff;
+uint8_t Si5351mcu::fracMath(uint8_t clk, uint32_t fvco, uint32_t freq, uint8_t *regs) {
+    uint8_t R = 0;
+    uint16_t max = clk >= 6 ? 254 : 2048;
+    uint32_t a, b, c = freq, f;
 
-    // reset the PLLs to apply the correction
-    reset();
-}
+    if (!freq) return 0;
 
+    while (fvco / c > max) {
+        if (R == 0x70) return 0;
+        c <<= 1;
+        R += 16;
+    }
 
-/*****************************************************************************
- * This function enables the selected output
- *
- * Beware: ZERO is clock output enabled, in register 16+CLK
- *****************************************************************************/
-void Si5351mcu::enable(uint8_t clk) {
-    // var to handle the mask of the registers value
-    uint8_t m = SICLK0_R;
-    
-    if (clk > 0) {
-      m = SICLK12_R;
+    a = fvco / c;
+    b = fvco % c;
+
+    // even integer
+    if (!b && !(a & 1) && (a >= 8 || (clk < 6 && a == 4) || a == 6)) {
+        if (regs) {
+            if (clk >= 6) {
+                regs[0] = a;
+                regs[1] = R;
+            } else {
+                msBank(regs, a, R);
+            }
+        }
+
+        return 2;
     }
 
-    // write the register value
-    i2cWrite(16 + clk, m + clkpower[clk]);
+    // fractional, a + b/c with c of 20 bits at most
+    if (clk >= 6 || a < 8) return 0;
 
-    // 1 & 2 are mutually exclusive
-    if (clk == 1) disable(2);
-    if (clk == 2) disable(1);
+    if (regs) {
+        while (c > 0xFFFFF) {
+            c >>= 1;
+            b >>= 1;
+        }
 
-    // update the status of the clk
-    clkOn[clk] = 1;
-}
+        f = (128 * b) / c;
+        pllBank(regs, 128 * a + f - 512, 128 * b - f * c, c);
+        regs[2] |= R;
+    }
 
+    return 1;
+}
 
 /*****************************************************************************
- * This function disables the selected output
- *
- * Beware: ONE is clock output disabled, in register 16+CLK
- * *****************************************************************************/
-void Si5351mcu::disable(uint8_t clk) {
-    // send
-    i2cWrite(16 + clk, 0x80);
+ * Write the integer output divider & R of a clk
+ ****************************************************************************/
+void Si5351mcu::msWrite(uint8_t clk, uint16_t outdivider, uint8_t R) {
+    uint8_t regs[8];
 
-    // update the status of the clk
-    clkOn[clk] = 0;
-}
+    // it was a fractional follower
+    if (clkfrac & (1 << clk)) {
+        clkfrac &= ~(1 << clk);
+        if (clkOn[clk]) i2cWrite(16 + clk, clkCtrl(clk));
+    }
 
+    if (clk >= 6) {
+        ms67(clk, outdivider, R);
+        return;
+    }
 
-/****************************************************************************
- * Set the power output for each output independently
- ***************************************************************************/
-void Si5351mcu::setPower(uint8_t clk, uint8_t power) {
-    // set the power to the correct var
-    clkpower[clk] = power;
+    msBank(regs, outdivider, R);
 
-    // now enable the output to get it applied
-    enable(clk);
+    // CLK# registers are exactly 8 * clk# bytes stride from a base register.
+    i2cWriteBurst(42 + clk * 8, regs, sizeof(regs));
 }
 
-/****************************************************************************
- * method to send multi-byte burst register data.
- ***************************************************************************/
-uint8_t Si5351mcu::i2cWriteBurst( const uint8_t start_register, 
-                                const uint8_t *data, 
-                                const uint8_t numbytes) {
+/*****************************************************************************
+ * MS6 & MS7 are just the integer divider in reg 90/91, the R dividers are
+ * in reg 92: R6 in bits [2:0] & R7 in bits [6:4]
+ ****************************************************************************/
+void Si5351mcu::ms67(uint8_t clk, uint8_t outdivider, uint8_t R) {
+    if (clk == 6) {
+        r92 = (r92 & 0x70) | (R >> 4);
+    } else {
+        r92 = (r92 & 0x07) | R;
+    }
 
-    // This method saves the massive overhead of having to keep opening
-    // and closing the I2C bus for consecutive register writes.  It 
-    // also saves numbytes - 1 writes for register address selection.
-    Wire.beginTransmission(SIADDR);
-
-    Wire.write(start_register);
-    Wire.write(data, numbytes);
-    // All of the bytes queued up in the above write() calls are buffered
-    // up and will be sent to the slave in one "burst", on the call to
-    // endTransmission().  This also sends the I2C STOP to the Slave.
-    return Wire.endTransmission();
-    // returns non zero on error
+    i2cWrite(90 + clk - 6, outdivider);
+    i2cWrite(92, r92);
 }
 
-/****************************************************************************
- * function to send the register data to the Si5351, arduino way.
- ***************************************************************************/
-void Si5351mcu::i2cWrite( const uint8_t regist, const uint8_t value) {
-    // Using the "burst" method instead of 
-    // doing it longhand saves a few bytes
-    i2cWriteBurst( regist, &value, 1);
-        
-}
+/*****************************************************************************
+ * The CLKx control register value: PLL, integer mode & power
+ ****************************************************************************/
+uint8_t Si5351mcu::clkCtrl(uint8_t clk) {
+    uint8_t m = SICLK0_R;
 
-/****************************************************************************
- * Read i2C register, returns -1 on error or timeout
- ***************************************************************************/
-int16_t  Si5351mcu::i2cRead( const uint8_t regist ) {
-    int value;
+    if (clkpll & (1 << clk)) m = SICLK12_R;
+    if (clkfrac & (1 << clk)) m &= ~0x40;
 
-    Wire.beginTransmission(SIADDR);
-    Wire.write(regist);
-    Wire.endTransmission();
-    
-    Wire.requestFrom(SIADDR, 1);
-    if ( Wire.available() ) {
-      value = Wire.read();
-    }
-    else {
-      value = -1;   // "EOF" in C
-    }
+    return m + clkpower[clk];
+}
 
-    return value;
+
+/*****************************************************************************
+ * Output divider planner, the output divider & R for a freq on a clk
+ *
+ * Every output divider change needs a reset (click noise, a bus transaction
+ * and the PLL settling time) so we keep the actual divider while the VCO is
+ * still in the legal range (SI_VCO_MIN to SI_VCO_MAX) with it.
+ *
+ * When it must change we look at the direction we are moving:
+ * - Going down (or unknown): the biggest divider, the VCO starts at the top
+ *   of the range and has all the way down to move (the default one)
+ * - Going up: the smallest divider that keeps the VCO over the minimum, the
+ *   VCO starts at the bottom and has all the way up to move.
+ *
+ * Any way each divider covers a 1.5:1 window (with the default VCO range)
+ * and a sweep sees a reset at most once per window.
+ *
+ * planDiv() is the rule itself, from the actual divider & R (0 if none) and
+ * the last freq (0 if not known); the sequencer uses it too.
+ ****************************************************************************/
+uint16_t Si5351mcu::plan(uint8_t clk, uint32_t freq, uint8_t &R) {
+    uint16_t d;
+
+    R = o_Rdiv[clk];
+    d = planDiv(omsynth[clk], R, clkfreq[clk], freq, clk >= 6);
+
+    // quadrature: the phase offset is 7 bits, even dividers up to 126 & no
+    // R (tune() checks the VCO is still in range)
+    if (clk == quadI && (d > 126 || R)) {
+        d = 126;
+        R = 0;
+    }
+
+    return d;
+}
+
+uint16_t Si5351mcu::planDiv(uint16_t odiv, uint8_t &R, uint32_t last, uint32_t freq, bool ms67) {
+    uint32_t step, total, outdivider;
+    uint8_t s;
+
+    // keep the actual dividers if the VCO is in range
+    if (odiv) {
+        step = (uint32_t)odiv << (R >> 4);
+        if (step <= SI_VCO_MAX / freq &&
+            step * freq >= SI_VCO_MIN) {
+            return odiv;
+        }
+    }
+
+    // going up: the smallest (even) divider with the VCO over the minimum
+    if (last && freq > last && !ms67) {
+        total = (SI_VCO_MIN + freq - 1) / freq;
+
+        for (s = 0; s < 8; s++) {
+            outdivider = (total + (1 << s) - 1) >> s;
+            outdivider += outdivider & 1;
+            if (outdivider < 4) outdivider = 4;
+
+            if (outdivider <= 900) {
+                if ((outdivider << s) * freq <= SI_VCO_MAX) {
+                    R = s << 4;
+                    return outdivider;
+                }
+                break;
+            }
+        }
+    }
+
+    // going down, unknown or no luck: the default
+    outdivider = divider(freq, R);
+
+    // MS6 & MS7 are up to 254, move it to R
+    if (ms67) {
+        while (outdivider > 254 && R < 0x70) {
+            outdivider = (outdivider >> 1) & ~1;
+            R += 16;
+        }
+    }
+
+    return outdivider;
+}
+
+
+/*****************************************************************************
+ * The output divider (even) & R for a freq, R is returned as the bits for
+ * the register 44 (log2(R) << 4)
+ ****************************************************************************/
+uint16_t Si5351mcu::divider(uint32_t freq, uint8_t &R) {
+    uint32_t outdivider;
+
+    R = 1;
+
+    // Overclock option
+    // user a overclock setting for the VCO, max value in my hardware
+    // was 1.05 to 1.1 GHz, as usual YMMV [See README.md for details]
+    //
+    // normal VCO from the datasheet and AN
+    // With 900 MHz beeing the maximum internal PLL-Frequency
+    outdivider = SI_VCO_MAX / freq;
+
+    // use additional Output divider ("R")
+    while (outdivider > 900) {
+        R = R * 2;
+        outdivider = outdivider / 2;
+    }
+
+    // finds the even divider which delivers the intended Frequency
+    if (outdivider % 2) outdivider--;
+
+    // Convert the Output Divider to the bit-setting required in register 44
+    switch (R) {
+        case 1:   R = 0; break;
+        case 2:   R = 16; break;
+        case 4:   R = 32; break;
+        case 8:   R = 48; break;
+        case 16:  R = 64; break;
+        case 32:  R = 80; break;
+        case 64:  R = 96; break;
+        case 128: R = 112; break;
+    }
+
+    return outdivider;
+}
+
+
+/*****************************************************************************
+ * The high precision PLL math: the VCO is fvco + extra / 1000 Hz (extra is
+ * the milli Hz times the output divider & R). Static and called by tune()
+ * through fineMath, so only the sketches with a setFreqMilli() link it.
+ *
+ * The registers hold (P1 + 512 + P2 / P3) / 128, so we don't need to go by
+ * the a + b/c of the AN: P1 takes a and the 1/128 steps of the fraction
+ * and P2 / P3 the rest (y below), with P3 up to 20 bits that's a VCO step
+ * of xtal / 128 / 2^20, ~0.2 Hz at worst and way less most of the time.
+ *
+ * P2 / P3 is the best rational approximation of y with P3 <= 1048575, by
+ * the continued fraction of y: the convergents get closer on each round,
+ * and when the next one is over the limit the best semiconvergent between
+ * them is taken. At most ~30 rounds for a 20 bits denominator, and the
+ * divisions are 32 bits ones after the first rounds.
+ ****************************************************************************/
+void Si5351mcu::pllFine(uint32_t xtal, uint32_t fvco, uint32_t extra, uint32_t &P1, uint32_t &P2, uint32_t &P3) {
+    uint64_t n, d, q, t;
+    uint32_t a, k, p0 = 1, q0 = 0, p1 = 0, q1 = 1;
+
+    // fvco / xtal = a + (rem * 1000 + extra) / (xtal * 1000)
+    a = fvco / xtal;
+    d = (uint64_t)xtal * 1000;
+    n = (uint64_t)(fvco % xtal) * 1000 + extra;
+    if (n >= d) {
+        n -= d;
+        a++;
+    }
+
+    // 128 times the fraction: k in 1/128 steps and y = n / d the rest
+    n <<= 7;
+    k = n / d;
+    n -= (uint64_t)k * d;
+
+    // continued fraction of y = [0; q, q, ...], convergents p1 / q1
+    for (uint8_t i = 0; i < 40 && n; i++) {
+        if (d >> 32) {
+            q = d / n;
+            t = d % n;
+        } else {
+            q = (uint32_t)d / (uint32_t)n;
+            t = (uint32_t)d % (uint32_t)n;
+        }
+
+        if (q > 1048575 || q * q1 + q0 > 1048575) {
+            // over the limit: the best semiconvergent, if it's better
+            // than the last convergent (more than half the way)
+            q = (1048575 - q0) / q1;
+            if (2 * q > d / n) {
+                p1 = q * p1 + p0;
+                q1 = q * q1 + q0;
+            }
+            break;
+        }
+
+        d = n;
+        n = t;
+
+        t = q * p1 + p0;
+        p0 = p1;
+        p1 = t;
+        t = q * q1 + q0;
+        q0 = q1;
+        q1 = t;
+    }
+
+    // a y very close to 1 may end as 1/1
+    if (p1 >= q1) {
+        k++;
+        p1 -= q1;
+    }
+
+    P1 = 128 * a + k - 512;
+    P2 = p1;
+    P3 = q1;
+}
+
+/*****************************************************************************
+ * Build the 8 bytes of an output multisynth bank (integer mode) from the
+ * output divider & R bits
+ ****************************************************************************/
+void Si5351mcu::msBank(uint8_t *regs, uint16_t outdivider, uint8_t R) {
+    // we have now the integer part of the output msynth
+    uint32_t MSx_P1 = 128 * (uint32_t)outdivider - 512;
+
+    // See datasheet, special trick when MSx == 4
+    //    MSx_P1 is always 0 if outdivider == 4, from the above equations, so there is 
+    //    no need to set it to 0. ... MSx_P1 = 128 * outdivider - 512;
+    //  
+    //        See para 4.1.3 on the datasheet.
+    // 
+    
+    if ( outdivider == 4 ) {
+      R |= 0x0C;    // bit set OR mask for MSYNTH divide by 4, for reg 44 {3:2]
+    }
+    
+    // HEX makes it easier to human read on bit shifts
+    regs[0] = 0;                    // Bits [15:8] of MS0_P3 (always 0) in register 42
+    regs[1] = 1;                    // Bits [7:0]  of MS0_P3 (always 1) in register 43
+    regs[2] = ((MSx_P1 & 0x030000L ) >> 16) | R;  // Bits [17:16] of MSx_P1 in bits [1:0] and R in [7:4] | [3:2]
+    regs[3] = (MSx_P1 & 0xFF00) >> 8;   // Bits [15:8]  of MSx_P1 in register 45
+    regs[4] = MSx_P1 & 0xFF;        // Bits [7:0]  of MSx_P1 in register 46
+    regs[5] = 0;                    // Bits [19:16] of MS0_P2 and MS0_P3 are always 0
+    regs[6] = 0;                    // Bits [15:8]  of MS0_P2 are always 0
+    regs[7] = 0;                    // Bits [7:0]   of MS0_P2 are always 0
+}
+
+
+/*****************************************************************************
+ * The PLL a + b/c math, from the VCO freq: returns the MSNx_P1 & MSNx_P2
+ * (MSNx_P3 is int_xtal >> 5) and the remainder of fvco / int_xtal
+ ****************************************************************************/
+uint32_t Si5351mcu::pllMath(uint32_t fvco, uint32_t &P1, uint32_t &P2) {
+    uint8_t a;
+    uint32_t b, c, f, rem;
+
+    /***************************************************************************
+    * We will use integer only on the b/c relation, and will >> 5 (/32) both
+    * to fit it on the 1048 k limit of C and keep the relation
+    * the most accurate possible, this works fine with xtals from
+    * 24 to 28 Mhz.
+    *
+    * This will give errors of about +/- 2 Hz maximum up to ~50 MHz
+    * as per my test and simulations in the worst case, well below the
+    * XTAl ppm error... Above that it's up to 32 Hz of the VCO over the
+    * output divider (~7 Hz at 225 MHz), see extras/host/si5351_accuracy.cpp
+    *
+    * This will free more than 1K of the final eeprom
+    *
+    ****************************************************************************/
+    a = fvco / int_xtal;
+    rem = fvco % int_xtal;
+    b = rem >> 5;                   // Integer part of the fraction
+                                    // scaled to match "c" limits
+    c = int_xtal >> 5;              // "c" scaled to match it's limits
+                                    // in the register
+
+    // f is (128*b)/c to mimic the Floor(128*(b/c)) from the datasheet
+    f = (128 * b) / c;
+
+    // build the registers to write
+    P1 = 128 * a + f - 512;
+    P2 = 128 * b - f * c;
+
+    return rem;
+}
+
+
+/*****************************************************************************
+ * Build the 8 bytes of a PLL (MSNx) bank from the P1/P2/P3 values
+ ****************************************************************************/
+void Si5351mcu::pllBank(uint8_t *regs, uint32_t P1, uint32_t P2, uint32_t P3) {
+    // HEX makes it easier to human read on bit shifts
+    regs[0] = (P3 & 0xFF00) >> 8;       // Bits [15:8] of MSNx_P3 in register 26
+    regs[1] = P3 & 0xFF;
+    regs[2] = (P1 & 0x030000L) >> 16;
+    regs[3] = (P1 & 0xFF00) >> 8;       // Bits [15:8]  of MSNx_P1 in register 29
+    regs[4] = P1 & 0xFF;                // Bits [7:0]  of MSNx_P1 in register 30
+    regs[5] = ((P3 & 0x0F0000L) >> 12) | ((P2 & 0x0F0000) >> 16); // Parts of MSNx_P3 and MSNx_P1
+    regs[6] = (P2 & 0xFF00) >> 8;       // Bits [15:8]  of MSNx_P2 in register 32
+    regs[7] = P2 & 0xFF;                // Bits [7:0]  of MSNx_P2 in register 33
+}
+
+
+/*****************************************************************************
+ * Division free fast path for setFreq()
+ *
+ * When the output divider and R will not change (the usual case while tuning
+ * in small steps) the new PLL numerator is derived from the last one: the VCO
+ * moves (freq - last freq) * outdivider * R Hz and we carry that over the
+ * a + b/c parts with a few adds and compares, instead of doing the four 32 bit
+ * divisions of the full math; those are really slow on 8 bit MCUs.
+ *
+ * It gives the exact same register values as the full math; if the
+ * dividers will change or the step is too big it returns false and the full
+ * math must be used.
+ ****************************************************************************/
+bool Si5351mcu::fastPll(uint8_t clk, uint32_t freq, uint32_t &P1, uint32_t &P2) {
+    uint32_t step, fvco, c = int_xtal >> 5;
+    int32_t dv, rem, dt, p2;
+    uint16_t n;
+
+    // no previous data, or a jump so big the math below may overflow
+    if (!o_freq[clk] || freq > (o_freq[clk] << 1)) return false;
+
+    // the VCO for the new freq with the same dividers
+    step = (uint32_t)omsynth[clk] << (o_Rdiv[clk] >> 4);
+    fvco = step * freq;
+
+    // will the planner keep the same dividers? that is: the VCO is in range
+    if (fvco < SI_VCO_MIN || fvco > SI_VCO_MAX) return false;
+
+    // VCO delta, must be less than one xtal to move "a" by one at most
+    dv = fvco - step * o_freq[clk];
+    if (dv >= (int32_t)int_xtal || -dv >= (int32_t)int_xtal) return false;
+
+    // new remainder of fvco / xtal, carry over "a"
+    rem = o_rem[clk] + dv;
+    dt = 0;
+    if (rem >= (int32_t)int_xtal) {
+        rem -= int_xtal;
+        dt = c;
+    } else if (rem < 0) {
+        rem += int_xtal;
+        dt = -(int32_t)c;
+    }
+
+    // 128 * (delta_a * c + delta_b) is what moves on P1 * c + P2
+    dt = (dt + (rem >> 5) - (o_rem[clk] >> 5)) * 128;
+    if (dt >= (int32_t)(c << 3) || -dt >= (int32_t)(c << 3)) return false;
+
+    // carry it over P1 (+512) & P2, 8 loops at most
+    n = o_N[clk];
+    p2 = o_P2[clk] + dt;
+    while (p2 >= (int32_t)c) {
+        p2 -= c;
+        n++;
+    }
+    while (p2 < 0) {
+        p2 += c;
+        n--;
+    }
+
+    // keep it for the next call
+    o_freq[clk] = freq;
+    o_rem[clk]  = rem;
+    o_N[clk]    = n;
+    o_P2[clk]   = p2;
+
+    P1 = n - 512;
+    P2 = p2;
+
+    return true;
+}
+
+
+/*****************************************************************************
+ * Reset of the PLLs and multisynths output enable
+ *
+ * This must be called to soft reset the PLLs and cycle the output of the
+ * multisynths: this is the "click" noise source in the RF spectrum.
+ *
+ * So it must be avoided at all costs, so this lib just call it at the
+ * initialization of the PLLs and when a correction is applied
+ *
+ * If you are concerned with accuracy you can implement a reset every
+ * other Mhz to be sure it get exactly on spot.
+ ****************************************************************************/
+void Si5351mcu::reset(void) {
+    resetBits(0xA0);
+}
+
+// the lib own resets: just the PLL (0/1) that moved, the outputs on the
+// other one don't click
+void Si5351mcu::resetPll(uint8_t pll) {
+    resetBits(0x20 << (pll * 2));
+}
+
+// inside a transaction or in async mode it's done once after the pending
+// writes, for all the PLLs asked for
+void Si5351mcu::resetBits(uint8_t bits) {
+    if (batch || queued) {
+        reset_pending |= bits;
+        return;
+    }
+
+    pllReset(bits);
+}
+
+// the real thing: soft-resets PLL A (32) and/or B (128) in just one step
+uint8_t Si5351mcu::pllReset(uint8_t bits) {
+    SI_COUNT(resets, 1);
+    return i2cWrite(177, bits);
+}
+
+
+/*****************************************************************************
+ * Function to disable all outputs
+ *
+ * The PLL are kept running, just the m-synths are powered off.
+ *
+ * This allows to keep the chip warm and exactly on freq the next time you
+ * enable an output.
+ ****************************************************************************/
+bool Si5351mcu::off(void) {
+    bool ok = true;
+
+    // This disable all the CLK outputs
+    for (byte i=0; i < channels; i++) {
+      ok &= disable(i);
+    }
+
+    return ok;
+}
+
+
+/*****************************************************************************
+ * Function to set the correction in Hz over the Si5351 XTAL.
+ *
+ * This will call a reset of the PLLs and multi-synths so it will produce a
+ * click every time it's called
+ ****************************************************************************/
+void Si5351mcu::correction(int32_t diff) {
+    // apply some corrections to the xtal
+    int_xtal = base_xtal + diff;
+
+    // the fast path data is no longer valid, a prepared hop neither
+    memset(o_freq, 0, sizeof(o_freq));
+    hopOff();
+
+    // reset the PLLs to apply the correction
+    reset();
+}
+
+
+/*****************************************************************************
+ * Click free correction, for GPSDO like loops that trim it all the time
+ *
+ * The enabled outputs are set again to the last freq with the new xtal: the
+ * output dividers are kept (they don't depend on the xtal) so only the PLL
+ * registers are written, merged in a single burst, no reset and no click.
+ *
+ * The disabled outputs will get it on the next setFreq()
+ ****************************************************************************/
+void Si5351mcu::correctionLive(int32_t diff) {
+    bool own = !batch;
+
+    // apply some corrections to the xtal
+    int_xtal = base_xtal + diff;
+
+    // the fast path data is no longer valid, a prepared hop neither
+    memset(o_freq, 0, sizeof(o_freq));
+    hopOff();
+
+    if (own) begin();
+
+    // a quadrature Q goes with its I
+    for (uint8_t clk = 0; clk < channels; clk++) {
+        if (clkOn[clk] && clkfreq[clk] && clk != quadQ) {
+            tune(clk, clkfreq[clk], clkmilli[clk], (clkfine >> clk) & 1);
+        }
+    }
+
+    if (own) commit();
+}
+
+
+/*****************************************************************************
+ * Click free correction in parts per billion of the base xtal, positive if
+ * the xtal is high
+ *
+ * The resolution is 1 Hz of the xtal, ~37 ppb at 27 MHz
+ ****************************************************************************/
+void Si5351mcu::correctionPpb(int32_t ppb) {
+    int64_t d = (int64_t)base_xtal * ppb;
+
+    // rounded to the nearest Hz
+    d += d < 0 ? -500000000L : 500000000L;
+    correctionLive((int32_t)(d / 1000000000L));
+}
+
+
+/*****************************************************************************
+ * This function enables the selected output
+ *
+ * Beware: ZERO is clock output enabled, in register 16+CLK
+ *****************************************************************************/
+bool Si5351mcu::enable(uint8_t clk) {
+    uint8_t pll;
+
+    if (clk >= channels) return false;
+
+    failed = false;
+
+    // back from a disable() it has no PLL, the allocator must track it
+    // again (or the others may move its VCO): the last freq is set again,
+    // or for an image (freq not known) the PLL it was on if still free; if
+    // it can't be done the output is left off
+    if (!(clkused & (1 << clk))) {
+        if (clkfreq[clk]) {
+            if (!tune(clk, clkfreq[clk], clkmilli[clk], (clkfine >> clk) & 1)) return false;
+        } else if (omsynth[clk]) {
+            pll = (clkpll >> clk) & 1;
+            if (pllowner[pll] != 0xFF || following(clk)) return false;
+            pllowner[pll] = clk;
+            clkused |= 1 << clk;
+        }
+    }
+
+    // write the register value: PLL, integer mode & power
+    i2cWrite(16 + clk, clkCtrl(clk));
+
+    // update the status of the clk (if the write failed it's pending, it
+    // will be sent again with the next write)
+    clkOn[clk] = 1;
+
+    return !failed;
+}
+
+
+/*****************************************************************************
+ * This function disables the selected output
+ *
+ * Beware: ONE is clock output disabled, in register 16+CLK
+ * *****************************************************************************/
+bool Si5351mcu::disable(uint8_t clk) {
+    if (clk >= channels) return false;
+
+    failed = false;
+
+    // the end of a quadrature pair, or a prepared hop
+    if (clk == quadI || clk == quadQ) quadOff();
+    if (clk == hopclk) hopOff();
+
+    // send
+    i2cWrite(16 + clk, 0x80);
+
+    // update the status of the clk
+    clkOn[clk] = 0;
+
+    // and it's not using a PLL anymore, others can move it so the fast
+    // path data is not good
+    clkused &= ~(1 << clk);
+    if (pllowner[0] == clk) pllowner[0] = 0xFF;
+    if (pllowner[1] == clk) pllowner[1] = 0xFF;
+    o_freq[clk] = 0;
+
+    return !failed;
+}
+
+
+/****************************************************************************
+ * Set the power output for each output independently
+ ***************************************************************************/
+bool Si5351mcu::setPower(uint8_t clk, uint8_t power) {
+    if (clk >= channels) return false;
+
+    // set the power to the correct var
+    clkpower[clk] = power;
+
+    // now enable the output to get it applied
+    return enable(clk);
+}
+
+/****************************************************************************
+ * Precomputed register images
+ *
+ * computeRegs() does the full setFreq() math once and keeps the PLL and
+ * output multisynth banks for that freq (16 bytes) so you can build a table
+ * of the frequencies you use over and over (band plans, the tones of a
+ * digital mode, the channels of a scanner) at startup; or at compile time
+ * in flash with the SI5351_REGS() macro, see the header.
+ *
+ * applyRegs() just send the image to CLKx, thanks to the shadow registers
+ * only the bytes that differ from the chip are sent, and the reset is
+ * only issued if the output multisynth changed. No math at all, so the
+ * time to switch tones is deterministic.
+ ***************************************************************************/
+bool Si5351mcu::computeRegs(uint32_t freq, Si5351regs &regs) {
+    uint8_t R;
+    uint16_t outdivider;
+    uint32_t P1, P2;
+
+    // the same range as setFreq()
+    if (freq < SI_FREQ_MIN || freq > SI_FREQ_MAX) return false;
+
+    outdivider = divider(freq, R);
+    pllMath((outdivider << (R >> 4)) * freq, P1, P2);
+    pllBank(regs.pll, P1, P2, int_xtal >> 5);
+    msBank(regs.ms, outdivider, R);
+
+    return true;
+}
+
+bool Si5351mcu::applyRegs(uint8_t clk, const Si5351regs &regs) {
+    uint8_t ms = 42 + clk * 8, pll = (clkpll >> clk) & 1;
+
+    // not for MS6 & MS7
+    if (clk >= channels || clk >= 6) return false;
+
+    failed = false;
+
+    // the image moves the VCO to a freq we don't know, so the clk must have
+    // a PLL on its own (see the PLL allocator): a free one or the one it
+    // owns with nobody following it, else nothing is touched
+    if (clk == quadQ) quadOff();
+    if (clk == hopclk) hopOff();
+    if (pllowner[pll] != clk) pll = alloc(clk);
+    if (pll > 1 || following(clk)) return false;
+
+    bool changed = !cached(ms, regs.ms, sizeof(regs.ms));
+
+    pllvco[pll] = 0;
+
+    i2cWriteBurst(26 + pll * 8, regs.pll, sizeof(regs.pll));
+
+    if (changed) {
+        i2cWriteBurst(ms, regs.ms, sizeof(regs.ms));
+
+        // keep track of the output divider for setFreq()
+        o_Rdiv[clk] = regs.ms[2] & 0x70;
+        if ((regs.ms[2] & 0x0C) == 0x0C) {
+            omsynth[clk] = 4;
+        } else {
+            omsynth[clk] = ((((uint32_t)(regs.ms[2] & 3) << 16) |
+                    ((uint16_t)regs.ms[3] << 8) | regs.ms[4]) + 512) >> 7;
+        }
+
+        // integer mode
+        if (clkfrac & (1 << clk)) {
+            clkfrac &= ~(1 << clk);
+            if (clkOn[clk]) i2cWrite(16 + clk, clkCtrl(clk));
+        }
+
+        resetPll(pll);
+    }
+
+    // we don't know the freq, setFreq() must do the full math next time
+    // and a live correction can't set it again
+    o_freq[clk] = 0;
+    clkfreq[clk] = 0;
+
+    return !failed;
+}
+
+bool Si5351mcu::applyRegs_P(uint8_t clk, const Si5351regs *regs) {
+    Si5351regs r;
+
+    memcpy_P(&r, regs, sizeof(r));
+    return applyRegs(clk, r);
+}
+
+/****************************************************************************
+ * Frequency hopping with the two PLLs (ping-pong)
+ *
+ * The next freq is programmed ahead of time on the PLL that is not feeding
+ * CLKx right now (the idle one) and hop() just flip the PLL source bit of the
+ * CLKx control register: that's a single 2 bytes I2C write, no reset and no
+ * click.
+ *
+ * As the output multisynth can't be changed without moving the output, the
+ * next freq must fit the actual output divider & R with the VCO in range
+ * (600-900 MHz, or the overclock limit), if not it returns false and you
+ * must use setFreq() for that jump.
+ *
+ * The hopping output holds both PLLs from hopPrepare() to hop(): it fails
+ * if any other output is on the idle PLL, and while prepared the allocator
+ * keeps the others off it. A setFreq(), applyRegs() or disable() of the
+ * output, or a correction, drops the prepared hop.
+ ***************************************************************************/
+bool Si5351mcu::hopPrepare(uint8_t clk, uint32_t freq) {
+    uint8_t idle, regs[8];
+    uint32_t fvco, P1, P2;
+
+    // we need a output divider in place, on a PLL we own
+    if (clk >= channels || !omsynth[clk]) return false;
+    if (pllowner[(clkpll >> clk) & 1] != clk) return false;
+
+    // nobody else on (or holding) the idle PLL
+    idle = (~clkpll >> clk) & 1;
+    if (clkused & (idle ? clkpll : ~clkpll)) return false;
+    if (pllowner[idle] != 0xFF && pllowner[idle] != clk) return false;
+
+    // the VCO with the actual output dividers
+    fvco = ((uint32_t)omsynth[clk] << (o_Rdiv[clk] >> 4)) * freq;
+    if (fvco < SI_VCO_MIN || fvco > SI_VCO_MAX) return false;
+
+    failed = false;
+
+    pllMath(fvco, P1, P2);
+    pllBank(regs, P1, P2, int_xtal >> 5);
+    i2cWriteBurst(26 + idle * 8, regs, sizeof(regs));
+    pllvco[idle] = fvco;
+
+    // hold it
+    pllowner[idle] = clk;
+    hopclk = clk;
+    hopfreq = freq;
+
+    return !failed;
+}
+
+bool Si5351mcu::hop(uint8_t clk) {
+    uint8_t pll;
+
+    // nothing prepared for this clk, or the idle PLL is not ours anymore
+    if (clk >= channels || clk != hopclk) return false;
+    pll = (clkpll >> clk) & 1;
+    if (pllowner[pll ^ 1] != clk) return false;
+
+    failed = false;
+
+    // swap the PLL, and the ownership
+    pllowner[pll] = 0xFF;
+    clkpll ^= 1 << clk;
+    hopclk = 0xFF;
+
+    // the fast path data is for the other PLL, the freq is the prepared one
+    o_freq[clk] = 0;
+    clkfreq[clk] = hopfreq;
+    clkmilli[clk] = 0;
+    clkfine &= ~(1 << clk);
+
+    // apply it, if disabled it will be applied on the next enable
+    if (clkOn[clk]) i2cWrite(16 + clk, clkCtrl(clk));
+
+    return !failed;
+}
+
+// drop a prepared hop, the idle PLL is free again
+void Si5351mcu::hopOff(void) {
+    if (hopclk == 0xFF) return;
+
+    uint8_t idle = (~clkpll >> hopclk) & 1;
+    if (pllowner[idle] == hopclk) pllowner[idle] = 0xFF;
+    hopclk = 0xFF;
+}
+
+/****************************************************************************
+ * method to send multi-byte burst register data.
+ *
+ * The registers in the shadow range are compared against what was last
+ * written to the chip: the unchanged leading bytes are not sent and if
+ * nothing changed the write is skipped entirely.
+ *
+ * The tail of the burst is always sent (from the first changed byte to the
+ * end) as the chip may latch the new divider values on the write of the
+ * last register of a bank. On a small tuning step only the low bytes of
+ * MSNx_P2 move, that's 2 or 3 bytes instead of the whole 8 bytes bank.
+ *
+ * Inside a begin()/commit() transaction the bytes are just marked as
+ * pending on the shadow, and sent on the commit.
+ ***************************************************************************/
+uint8_t Si5351mcu::i2cWriteBurst( const uint8_t start_register,
+                                const uint8_t *data,
+                                const uint8_t numbytes) {
+    uint8_t i = 0, s, err = 0;
+    bool later = batch || queued;
+
+    // a write failed before: the chip gets all we know again first, and if
+    // that fails too nothing goes on top of it, this write is left pending
+    if (dirty && !later && (err = flush())) later = true;
+
+    // out of the shadow range, straight to the chip; on a failed flush it's
+    // dropped (what the lib sets there goes with the replay, see I2C errors)
+    if (start_register < SI_SHADOW_FIRST ||
+        start_register + numbytes - 1 > SI_SHADOW_LAST) {
+        if (err) return err;
+        err = i2cSend(start_register, data, numbytes);
+        if (err) fault();
+        return err;
+    }
+
+    // skip the leading bytes that are already in the chip (or pending)
+    s = start_register - SI_SHADOW_FIRST;
+    while (i < numbytes && SI_KNOWN(s + i) && shadow[s + i] == data[i]) {
+        i++;
+    }
+
+    // nothing changed
+    if (i == numbytes) return err;
+
+    if (!later) err = i2cSend(start_register + i, data + i, numbytes - i);
+
+    // keep track of what the chip has now (or will have on the commit),
+    // if the write failed we don't really know: it's pending again
+    for (; i < numbytes; i++) {
+        shadow[s + i] = data[i];
+        SI_CLR(shadow_ok, s + i);
+        SI_CLR(shadow_dirty, s + i);
+        if (later || err) {
+            SI_SET(shadow_dirty, s + i);
+        } else {
+            SI_SET(shadow_ok, s + i);
+        }
+    }
+
+    if (err) fault();
+
+    return err;
+}
+
+/****************************************************************************
+ * true if the chip already has these values (or will have on the commit)
+ ***************************************************************************/
+bool Si5351mcu::cached(const uint8_t start_register, const uint8_t *data, const uint8_t numbytes) {
+    uint8_t s = start_register - SI_SHADOW_FIRST;
+
+    if (start_register < SI_SHADOW_FIRST ||
+        start_register + numbytes - 1 > SI_SHADOW_LAST) return false;
+
+    for (uint8_t i = 0; i < numbytes; i++, s++) {
+        if (!SI_KNOWN(s) || shadow[s] != data[i]) return false;
+    }
+
+    return true;
+}
+
+/****************************************************************************
+ * Batched transactions
+ *
+ * Between begin() and commit() all register writes are collected on the
+ * shadow registers and any reset is delayed; the commit sends them in as
+ * few bursts as possible and then issue a single reset if any was asked.
+ *
+ * As PLLA & PLLB (26..41) and the multisynths are contiguous, small gaps of
+ * known registers (up to SI_BATCH_GAP bytes) are sent again to merge two
+ * bursts in one; a retune of two outputs (LO & BFO) moving just the PLLs is
+ * a single burst.
+ *
+ * The writes to registers out of the shadow range (149, 177...) are not
+ * delayed.
+ *
+ * In async mode the commit just close the transaction, pump() will send it.
+ ***************************************************************************/
+void Si5351mcu::begin(void) {
+    batch = true;
+}
+
+uint8_t Si5351mcu::commit(void) {
+    batch = false;
+    if (queued) return 0;
+
+    return flush();
+}
+
+/****************************************************************************
+ * send all the pending writes and the reset; a failed write stops it, the
+ * rest is left pending (see "I2C errors" below)
+ ***************************************************************************/
+uint8_t Si5351mcu::flush(void) {
+    uint8_t first, len, bits, err = 0;
+    bool again = dirty;
+
+    dirty = false;
+    while (!err && nextSpan(first, len)) {
+        err = sendSpan(first, len);
+    }
+
+    if (!err && again) err = replay();
+
+    if (!err && reset_pending) {
+        bits = reset_pending;
+        reset_pending = 0;
+        err = pllReset(bits);
+    }
+
+    return err;
+}
+
+/****************************************************************************
+ * Async mode (non blocking writes)
+ *
+ * The Wire lib blocks until the whole burst is on the bus (~1 msec for a
+ * 8 bytes bank at 100 kHz), too much for an encoder ISR or a DSP loop.
+ *
+ * In async mode setFreq() & friends just compute the registers and leave
+ * them pending on the shadow, pump() sends them later from the main loop,
+ * one burst per call, and the reset (if any) when all is out.
+ *
+ * As the shadow holds just the last value of each register, a new freq for
+ * a channel replaces the pending one (latest wins): a fast spin of the knob
+ * don't pile up a backlog of stale retunes, just the last one goes out.
+ *
+ * Turning it off flush all the pending writes.
+ ***************************************************************************/
+void Si5351mcu::setAsync(bool on) {
+    queued = on;
+
+    if (!on) while (pump());
+}
+
+/****************************************************************************
+ * send the next pending burst (or the reset), returns true if there is
+ * still more to send
+ ***************************************************************************/
+bool Si5351mcu::pump(void) {
+    uint8_t first, len;
+
+    // no partial transactions on the bus
+    if (batch) return true;
+
+    // a failed write (after the retries) stops the pumping for now, it's
+    // pending and will go on the next pump()
+    if (nextSpan(first, len)) {
+        if (sendSpan(first, len)) return false;
+    } else if (reset_pending) {
+        if (dirty && replay()) return false;
+        len = reset_pending;
+        reset_pending = 0;
+        if (pllReset(len)) return false;
+    }
+
+    if (pending()) return true;
+
+    dirty = false;
+    return false;
+}
+
+/****************************************************************************
+ * true if there are writes (or a reset) waiting for a pump()
+ ***************************************************************************/
+bool Si5351mcu::pending(void) {
+    for (uint8_t i = 0; i < sizeof(shadow_dirty); i++) {
+        if (shadow_dirty[i]) return true;
+    }
+
+    return reset_pending != 0;
+}
+
+/****************************************************************************
+ * Several chips in async mode: a pump() to each one in turns, so a burst for
+ * each chip goes out on each pass instead of draining them one by one
+ ***************************************************************************/
+bool Si5351mcu::pumpAll(void) {
+    bool more = false;
+
+    for (Si5351mcu *s = chain; s; s = s->next) {
+        if (s->pump()) more = true;
+    }
+
+    return more;
+}
+
+/****************************************************************************
+ * find the next span of pending registers (shadow index & len) to send in a
+ * burst, merging the gaps as explained above. Returns false if none.
+ ***************************************************************************/
+bool Si5351mcu::nextSpan(uint8_t &first, uint8_t &len) {
+    uint8_t i = 0, last, g;
+
+    while (i < SI_SHADOW_SIZE && !SI_BIT(shadow_dirty, i)) i++;
+    if (i == SI_SHADOW_SIZE) return false;
+
+    first = last = i++;
+    while (i < SI_SHADOW_SIZE && i - first < SI_BURST_MAX) {
+        if (SI_BIT(shadow_dirty, i)) {
+            last = i++;
+            continue;
+        }
+
+        // a gap, can we bridge it?
+        g = i;
+        while (g < SI_SHADOW_SIZE && g - i < SI_BATCH_GAP &&
+               !SI_BIT(shadow_dirty, g) && SI_BIT(shadow_ok, g)) g++;
+
+        if (g < SI_SHADOW_SIZE && g - first < SI_BURST_MAX &&
+            SI_BIT(shadow_dirty, g)) {
+            i = g;
+        } else {
+            break;
+        }
+    }
+
+    len = last - first + 1;
+    return true;
+}
+
+/****************************************************************************
+ * send a span of the shadow to the chip and update the flags
+ *
+ * The span is copied & taken out of the pending ones before the (slow)
+ * write, if a setFreq() from an ISR changes it meanwhile it will be pending
+ * again and sent on the next pump().
+ ***************************************************************************/
+uint8_t Si5351mcu::sendSpan(uint8_t first, uint8_t len) {
+    uint8_t buf[SI_BURST_MAX] = { 0 }, i, err;
+
+    noInterrupts();
+    for (i = 0; i < len; i++) {
+        buf[i] = shadow[first + i];
+        SI_CLR(shadow_dirty, first + i);
+    }
+    interrupts();
+
+    err = i2cSend(SI_SHADOW_FIRST + first, buf, len);
+
+    noInterrupts();
+    for (i = first; i < first + len; i++) {
+        if (err) {
+            SI_CLR(shadow_ok, i);
+            SI_SET(shadow_dirty, i);
+        } else if (SI_BIT(shadow_dirty, i)) {
+            SI_CLR(shadow_ok, i);
+        } else {
+            SI_SET(shadow_ok, i);
+        }
+    }
+    interrupts();
+
+    if (err) fault();
+
+    return err;
+}
+
+/****************************************************************************
+ * raw burst write to the chip, not filtered by the shadow.
+ ***************************************************************************/
+uint8_t Si5351mcu::i2cSend( const uint8_t start_register, 
+                            const uint8_t *data, 
+                            const uint8_t numbytes) {
+    uint8_t err, n = 0;
+    SI_TIME_START();
+
+    while (true) {
+        // This method saves the massive overhead of having to keep opening
+        // and closing the I2C bus for consecutive register writes.  It
+        // also saves numbytes - 1 writes for register address selection.
+        // (write() & read() are virtual in the cores, qualified they are a
+        // direct call as with a plain Wire. object)
+        bus->beginTransmission(addr);
+
+        bus->TwoWire::write(start_register);
+        bus->TwoWire::write(data, numbytes);
+        // All of the bytes queued up in the above write() calls are buffered
+        // up and will be sent to the slave in one "burst", on the call to
+        // endTransmission().  This also sends the I2C STOP to the Slave.
+        err = bus->endTransmission();
+
+        SI_COUNT(writes, 1);
+        SI_COUNT(bytesWritten, numbytes + 1);
+
+        // a glitch or a busy bus: wait a bit (doubled each time) & again
+        if (!err || n == SI_I2C_RETRIES) break;
+        delayMicroseconds((uint32_t)SI_I2C_BACKOFF << n++);
+        SI_COUNT(retries, 1);
+    }
+
+    SI_TIME_COUNT();
+    SI_COUNT(errors, err != 0);
+
+    // returns non zero on error
+    return err;
+}
+
+/****************************************************************************
+ * I2C errors
+ *
+ * A write is retried SI_I2C_RETRIES times with a growing wait (see i2cSend)
+ * and if it still fails the bytes are left pending on the shadow, all the
+ * lib state (output dividers, fast path, clkOn...) is what it should be on
+ * the chip, it's the chip that is behind.
+ *
+ * And as we don't really know what the chip got (a glitch mid burst, a
+ * brown-out...) all we know it has is pending too and a reset: the next
+ * write sends the full register image first (the commit() or pump() in a
+ * transaction or async mode), never a partial fast path write over a chip
+ * that missed the output dividers. isDirty() tells you it's not done yet.
+ *
+ * A write to a register out of the shadow range (16..SI_SHADOW_LAST) can't
+ * be left pending: it's dropped while the chip is not in sync. The ones the
+ * lib owns there (spread spectrum off & the quadrature phase offsets) are
+ * sent again before the reset of the recovery (replay), but your own raw
+ * i2cWrite() out of that range are not, write them again after a resync().
+ *
+ * The calls that write (setFreq(), enable()...) return false if a write
+ * failed during the call.
+ ***************************************************************************/
+void Si5351mcu::fault(void) {
+    lost();
+    failed = true;
+}
+
+// the lib state out of the shadow range, on a recovery: a brown-out of the
+// chip brings back the spread spectrum and clears the phase offsets
+uint8_t Si5351mcu::replay(void) {
+    int16_t r149 = i2cRead(149);
+    uint8_t v, err = 0;
+
+    if (r149 < 0) {
+        err = 1;
+    } else if (r149 & 0x80) {
+        v = r149 & ~0x80;
+        err = i2cSend(149, &v, 1);
+    }
+
+    if (!err && quadQ < channels) {
+        v = 0;
+        err = i2cSend(165 + quadI, &v, 1);
+        if (!err) err = i2cSend(165 + quadQ, &quadN, 1);
+    }
+
+    if (err) fault();
+
+    return err;
+}
+
+// all we know goes again, with a reset
+void Si5351mcu::lost(void) {
+    noInterrupts();
+    for (uint8_t i = 0; i < sizeof(shadow_dirty); i++) {
+        shadow_dirty[i] |= shadow_ok[i];
+    }
+    interrupts();
+
+    reset_pending = 0xA0;
+    dirty = true;
+}
+
+/****************************************************************************
+ * send the full register image again, after a brown-out of the chip (see
+ * status(), SI_SYS_INIT) or to recover from a bus failure right now; false
+ * if it failed
+ ***************************************************************************/
+bool Si5351mcu::resync(void) {
+    lost();
+
+    if (batch || queued) return true;
+
+    return !flush();
+}
+
+/****************************************************************************
+ * function to send the register data to the Si5351, arduino way.
+ ***************************************************************************/
+uint8_t Si5351mcu::i2cWrite( const uint8_t regist, const uint8_t value) {
+    // Using the "burst" method instead of 
+    // doing it longhand saves a few bytes
+    return i2cWriteBurst( regist, &value, 1);
+}
+
+/****************************************************************************
+ * Read i2C register, returns -1 on error or timeout
+ ***************************************************************************/
+int16_t  Si5351mcu::i2cRead( const uint8_t regist ) {
+    uint8_t value;
+
+    if (i2cReadBurst(regist, &value, 1) != 1) return -1;   // "EOF" in C
+
+    return value;
+}
+
+/****************************************************************************
+ * Device status, reg 0: SYS_INIT, LOL_B, LOL_A, LOS_CLKIN & LOS_XTAL (see
+ * the SI_LOL_A & friends on the header) and the revision in bits [1:0].
+ * Returns -1 on error
+ ***************************************************************************/
+int16_t Si5351mcu::status(void) {
+    return i2cRead(0);
+}
+
+/****************************************************************************
+ * Sticky status, reg 1: same bits as the status but latched, they stay set
+ * until cleared; to know if something happened since the last look.
+ *
+ * The bits are cleared writing a 0 to them, a clear right after the read
+ * may lose an event in between (it's for diagnostics, not for alarms)
+ ***************************************************************************/
+int16_t Si5351mcu::sticky(bool clear) {
+    int16_t val = i2cRead(1);
+
+    if (clear && val > 0) i2cWrite(1, 0);
+
+    return val;
+}
+
+/****************************************************************************
+ * Wait for the PLLs in use to lock, polling the status register: a byte
+ * read every SI_LOCK_POLL uS, the first one is done right away so if the
+ * PLL is locked already (a small retune) it's a single read.
+ *
+ * Returns the settle time in uS (from the call), or -1 on timeout or if
+ * the chip can't be read.
+ *
+ * In async mode pump() the pending writes first, or you will be waiting
+ * for a PLL that has not been touched yet.
+ ***************************************************************************/
+int32_t Si5351mcu::waitLocked(uint32_t timeout) {
+    uint32_t start = micros(), t;
+    uint8_t mask = SI_SYS_INIT;
+    int16_t st;
+
+    // the PLLs with an output in use
+    if (clkused & ~clkpll) mask |= SI_LOL_A;
+    if (clkused & clkpll) mask |= SI_LOL_B;
+
+    for (;;) {
+        st = status();
+        t = micros() - start;
+
+        if (st >= 0 && !(st & mask)) return t;
+        if (t >= timeout) return -1;
+
+        delayMicroseconds(SI_LOCK_POLL);
+    }
+}
+
+/****************************************************************************
+ * Burst read of consecutive registers (the chip auto increments the register
+ * pointer), in chunks of the Wire buffer size: the full multisynth area is
+ * 2 or 3 reads instead of one read per register.
+ *
+ * Returns the count of bytes read, less than count on error or timeout
+ ***************************************************************************/
+uint8_t Si5351mcu::i2cReadBurst( const uint8_t start_register,
+                                 uint8_t *data,
+                                 const uint8_t count) {
+    uint8_t i = 0, n, t = 0;
+    bool err = false;
+    SI_TIME_START();
+
+    while (i < count) {
+        n = count - i;
+        if (n > SI_READ_MAX) n = SI_READ_MAX;
+
+        // set the register pointer and read from it
+        bus->beginTransmission(addr);
+        bus->TwoWire::write(start_register + i);
+        SI_COUNT(writes, 1);
+        SI_COUNT(bytesWritten, 1);
+        err = bus->endTransmission();
+        if (!err) {
+            SI_COUNT(reads, 1);
+            err = bus->requestFrom((int)addr, (int)n) != n;
+        }
+
+        // retried as the writes (see i2cSend)
+        if (err) {
+            if (t == SI_I2C_RETRIES) break;
+            delayMicroseconds((uint32_t)SI_I2C_BACKOFF << t++);
+            SI_COUNT(retries, 1);
+            continue;
+        }
+
+        SI_COUNT(bytesRead, n);
+        while (n--) data[i++] = bus->TwoWire::read();
+    }
+
+    SI_TIME_COUNT();
+    SI_COUNT(errors, err);
+
+    return i;
+}
+
+/****************************************************************************
+ * The P1/P2/P3 of a PLL or multisynth bank (8 registers)
+ ***************************************************************************/
+void Si5351mcu::unBank(const uint8_t *regs, Si5351div &d) {
+    d.P3 = ((uint32_t)(regs[5] & 0xF0) << 12) | ((uint32_t)regs[0] << 8) | regs[1];
+    d.P1 = ((uint32_t)(regs[2] & 0x03) << 16) | ((uint32_t)regs[3] << 8) | regs[4];
+    d.P2 = ((uint32_t)(regs[5] & 0x0F) << 16) | ((uint32_t)regs[6] << 8) | regs[7];
+}
+
+/****************************************************************************
+ * floor(a * b / c) without a 96 bits product, for c < 2^62.
+ *
+ * The integer part of a / c is done by the hardware (well, the compiler lib)
+ * and the remainder times b by shift & add, keeping the partial remainder
+ * below c; that's 32 rounds of shifts and compares, no floats.
+ ***************************************************************************/
+uint64_t Si5351mcu::mulDiv(uint64_t a, uint32_t b, uint64_t c) {
+    uint64_t q = a / c, r = a % c, acc = 0, rem = 0;
+
+    for (int8_t i = 31; i >= 0; i--) {
+        acc <<= 1;
+        rem <<= 1;
+        if (rem >= c) { rem -= c; acc++; }
+
+        if ((b >> i) & 1) {
+            rem += r;
+            if (rem >= c) { rem -= c; acc++; }
+        }
+    }
+
+    return q * b + acc;
+}
+
+/****************************************************************************
+ * A divider/multiplier from the registers times scale, rounded down:
+ *
+ *   (P1 + 512 + P2 / P3) / 128 = (P3 * (P1 + 512) + P2) / (128 * P3)
+ *
+ * Returns 0 if the bank is not valid (P3 = 0)
+ ***************************************************************************/
+uint64_t Si5351mcu::ratio(const Si5351div &d, uint32_t scale) {
+    if (!d.P3) return 0;
+
+    return mulDiv((uint64_t)d.P3 * (d.P1 + 512) + d.P2, scale, 128UL * d.P3);
+}
+
+/****************************************************************************
+ * Read the chip state and decode it, integer math only.
+ *
+ * Two reads: the status (regs 0..3) and all the CLKx control, PLL and
+ * multisynth registers we use (16..SI_SHADOW_LAST) in one burst, split in
+ * chunks of the Wire buffer.
+ *
+ * The freqs are in milli Hz, exact (rounded down) for the xtal the lib
+ * works with, the corrected one (see getXtalCurrent()):
+ *
+ *   fvco = xtal * (P3 * (P1 + 512) + P2) / (128 * P3)
+ *   fout = fvco * 128 * Q3 / ((Q3 * (Q1 + 512) + Q2) * R)
+ *
+ * The products go over 64 bits, see mulDiv()
+ ***************************************************************************/
+bool Si5351mcu::readState(Si5351state &st) {
+    uint8_t head[4], regs[SI_SHADOW_SIZE], clk, p;
+    const uint8_t *ms;
+
+    if (i2cReadBurst(0, head, 4) != 4) return false;
+    if (i2cReadBurst(SI_SHADOW_FIRST, regs, shadowSize) != shadowSize) return false;
+
+    st.status = head[0];
+    st.sticky = head[1];
+    st.oeb = head[3];
+
+    // PLLA & PLLB
+    for (p = 0; p < 2; p++) {
+        unBank(&regs[26 + 8 * p - SI_SHADOW_FIRST], st.pll[p]);
+
+        st.vco[p] = 0;
+        if (st.pll[p].P3) {
+            st.vco[p] = mulDiv(((uint64_t)st.pll[p].P3 * (st.pll[p].P1 + 512) +
+                                st.pll[p].P2) * 1000, int_xtal, 128UL * st.pll[p].P3);
+        }
+    }
+
+    // the outputs
+    for (clk = 0; clk < channels; clk++) {
+        Si5351clk &c = st.clk[clk];
+
+        c.ctrl = regs[16 + clk - SI_SHADOW_FIRST];
+        c.freq = 0;
+
+        if (clk < 6) {
+            ms = &regs[42 + 8 * clk - SI_SHADOW_FIRST];
+            unBank(ms, c.ms);
+            c.R = 1 << ((ms[2] >> 4) & 0x07);
+
+            // MSx_DIVBY4
+            if ((ms[2] & 0x0C) == 0x0C) {
+                c.ms.P1 = c.ms.P2 = 0;
+                c.ms.P3 = 1;
+            }
+        } else {
+            // MS6 & MS7 are just an integer divider
+            p = regs[90 + clk - 6 - SI_SHADOW_FIRST];
+            c.ms.P1 = 128UL * p - 512;
+            c.ms.P2 = 0;
+            c.ms.P3 = p < 4 ? 0 : 1;
+            c.R = 1 << ((regs[92 - SI_SHADOW_FIRST] >> (clk == 6 ? 0 : 4)) & 0x07);
+        }
+
+        // powered, enabled & fed by its own multisynth
+        if (!(c.ctrl & 0x80) && !(st.oeb & (1 << clk)) &&
+            (c.ctrl & 0x0C) == 0x0C && c.ms.P3) {
+            c.freq = mulDiv(st.vco[(c.ctrl >> 5) & 1], 128UL * c.ms.P3,
+                            ((uint64_t)c.ms.P3 * (c.ms.P1 + 512) + c.ms.P2) * c.R);
+        }
+    }
+
+    return true;
+}
+
+/****************************************************************************
+ * Quadrature (I/Q) LO
+ *
+ * Two outputs on the same freq with Q 90 degrees behind I, for the SDR
+ * front ends (Tayloe mixers & friends) that need them.
+ *
+ * Both go on the same PLL with the same even integer divider N: I owns the
+ * PLL and Q follows it (see the PLL allocator), and the phase offset of Q
+ * (reg 165 + clk, in quarters of the VCO period) is N, a quarter of the
+ * output period. The offset is 7 bits, so N is 126 at most and the lowest
+ * freq is ~4.8 MHz (600 MHz / 126), no R dividers.
+ *
+ * The offsets are only taken on a PLL reset, but that's needed just when N
+ * changes (and it's needed any way then): the retunes inside the divider
+ * window move just the PLL, the same click free bytes of a single output,
+ * and the phase relation holds as both multisynths count the same VCO.
+ *
+ * Call it again (or setFreq() on I) to retune the pair; a setFreq() on Q
+ * or a disable() of any of them ends it. CLK0 to CLK5 only. Returns false
+ * if the freq is too low or the pair can't get a PLL on its own.
+ ****************************************************************************/
+bool Si5351mcu::quadrature(uint8_t clkI, uint8_t clkQ, uint32_t freq) {
+    bool own = !batch, ok;
+
+    if (clkI >= channels || clkQ >= channels || clkI >= 6 || clkQ >= 6 ||
+        clkI == clkQ) return false;
+
+    // a new pair: Q off the PLLs so I can own one on its own, the fast path
+    // & the divider of I are not good to go (N up to 126)
+    if (quadI != clkI || quadQ != clkQ) {
+        quadOff();
+        if (clkQ == hopclk) hopOff();
+        clkused &= ~(1 << clkQ);
+        if (pllowner[0] == clkQ) pllowner[0] = 0xFF;
+        if (pllowner[1] == clkQ) pllowner[1] = 0xFF;
+        o_freq[clkI] = 0;
+        quadI = clkI;
+        quadQ = clkQ;
+    }
+
+    // all in one transaction, the reset (if any) after the phase offsets
+    if (own) begin();
+
+    ok = tune(clkI, freq, 0, false);
+
+    // I must own a PLL, Q joins it: the same integer divider, and the offsets
+    ok = ok && pllowner[(clkpll >> clkI) & 1] == clkI;
+    if (ok && !(clkused & (1 << clkQ))) {
+        clkpll = (clkpll & ~(1 << clkQ)) | (((clkpll >> clkI) & 1) << clkQ);
+        ok = follow(clkQ, freq) && ((clkpll >> clkQ) & 1) == ((clkpll >> clkI) & 1);
+        if (clkOn[clkQ]) i2cWrite(16 + clkQ, clkCtrl(clkQ));
+        quadN = omsynth[clkI];
+        i2cWrite(165 + clkI, 0);
+        i2cWrite(165 + clkQ, quadN);
+        resetPll((clkpll >> clkI) & 1);
+    }
+
+    if (own) commit();
+
+    if (!ok) quadOff();
+
+    return ok;
+}
+
+// end the quadrature pair, the Q offset back to 0 (on the next reset)
+void Si5351mcu::quadOff(void) {
+    if (quadQ < channels) i2cWrite(165 + quadQ, 0);
+    quadI = quadQ = 0xFF;
+    quadN = 0;
+}
+
+/****************************************************************************
+ * Sweep/hop sequencer
+ *
+ * A sweep (start, stop, step) or a list of freqs for an output, played with
+ * a fixed dwell per step (uS, scheduled from the start so there is no drift)
+ * or a step per tick() from a timer ISR.
+ *
+ * The steps are computed ahead by poll() while waiting, with the full math
+ * and the divider planner of setFreq() (so the resets fall just where the
+ * output divider must change, see plannedResets() & wasReset()), into a
+ * ring of frames with just what changes from the step before:
+ *
+ *   header: bit 7 a new output divider, bits 5..0 the PLL bank bytes 2..7
+ *           that change (P3, the first two, is the same for all)
+ *   the PLL bytes that change, in order
+ *   the 8 bytes of the output multisynth bank, on a new divider
+ *
+ * That's 2 to 4 bytes per step on a sweep, 15 at worst. Playing a step is
+ * just applyRegs() of the updated image: the I2C bytes that changed and a
+ * reset only on a new divider, no math at all; a 64 bytes ring is plenty
+ * for steps of a mS or more on an AVR.
+ *
+ * No I2C from the ISR: tick() just counts the steps due, poll() makes them.
+ * A late step is made at once and the next ones keep the schedule.
+ *
+ * The frames are computed with the xtal at the start, after a correction
+ * start the sequence again.
+ ****************************************************************************/
+Si5351seq::Si5351seq(Si5351mcu &nsi, uint8_t *nring, uint16_t nsize) :
+    si(nsi), ring(nring), size(nsize) {
+}
+
+bool Si5351seq::sweep(uint8_t nclk, uint32_t nstart, uint32_t nstop, uint32_t nstep,
+                      uint32_t ndwell, bool nloop) {
+    uint32_t n;
+
+    // the old sequence (if any) is gone, refused or not
+    stop();
+    if (!nstep) return false;
+
+    start = nstart;
+    flist = 0;
+    if (nstop >= nstart) {
+        step = nstep;
+        n = (nstop - nstart) / nstep + 1;
+    } else {
+        step = -(int32_t)nstep;
+        n = (nstart - nstop) / nstep + 1;
+    }
+
+    // up to 65535 steps
+    if (n > 0xFFFF) return false;
+    count = n;
+
+    return prepare(nclk, ndwell, nloop);
+}
+
+bool Si5351seq::list(uint8_t nclk, const uint32_t *freqs, uint16_t ncount,
+                     uint32_t ndwell, bool nloop) {
+    stop();
+    flist = freqs;
+    count = ncount;
+
+    return prepare(nclk, ndwell, nloop);
+}
+
+// the first step at once and the ring full
+bool Si5351seq::prepare(uint8_t nclk, uint32_t ndwell, bool nloop) {
+    uint16_t i;
+
+    // applyRegs() is not for MS6 & MS7, and a worst case frame must fit
+    if (nclk >= 6 || !count || size < 16) return false;
+
+    // all steps in the divider math range (0 Hz would divide by zero), a
+    // sweep goes one way so its ends will do
+    for (i = 0; i < count; i++) {
+        if (!flist && i) i = count - 1;
+        if (stepFreq(i) < SI_FREQ_MIN || stepFreq(i) > SI_FREQ_MAX) return false;
+    }
+
+    clk = nclk;
+    dwell = ndwell;
+    loop = nloop;
+    head = tail = used = 0;
+    due = 0;
+
+    // the planner starts from what the output has now
+    gdiv = si.omsynth[clk];
+    gR = si.o_Rdiv[clk];
+    glast = si.clkfreq[clk];
+    gstep = 0;
+    gdone = false;
+    compute(NULL);
+    sdiv = gdiv;
+    sR = gR;
+
+    pstep = 0;
+    pimg = gimg;
+    prun = false;
+    if (!apply()) return false;
+    prun = true;
+    pnext = micros() + dwell;
+
+    while (fill());
+
+    return true;
+}
+
+uint32_t Si5351seq::stepFreq(uint16_t i) {
+    return flist ? flist[i] : start + (uint32_t)(step * (int32_t)i);
+}
+
+/****************************************************************************
+ * compute the next step on the generator image and the frame with the
+ * changes (the full image if frame is NULL), returns the frame length
+ ****************************************************************************/
+uint8_t Si5351seq::compute(uint8_t *frame) {
+    uint8_t i, len = 1, R = gR, pll[8];
+    uint16_t div;
+    uint32_t f, P1, P2;
+
+    f = stepFreq(gstep);
+    div = Si5351mcu::planDiv(gdiv, R, glast, f, false);
+    si.pllMath(((uint32_t)div << (R >> 4)) * f, P1, P2);
+    Si5351mcu::pllBank(pll, P1, P2, si.int_xtal >> 5);
+
+    if (!frame) {
+        memcpy(gimg.pll, pll, sizeof(pll));
+        Si5351mcu::msBank(gimg.ms, div, R);
+    } else {
+        frame[0] = 0;
+        for (i = 2; i < 8; i++) {
+            if (pll[i] != gimg.pll[i]) {
+                frame[0] |= 1 << (i - 2);
+                frame[len++] = gimg.pll[i] = pll[i];
+            }
+        }
+        if (div != gdiv || R != gR) {
+            frame[0] |= 0x80;
+            Si5351mcu::msBank(gimg.ms, div, R);
+            memcpy(frame + len, gimg.ms, sizeof(gimg.ms));
+            len += sizeof(gimg.ms);
+        }
+    }
+
+    gdiv = div;
+    gR = R;
+    glast = f;
+
+    // the next one
+    if (++gstep == count) {
+        gstep = 0;
+        gdone = !loop;
+    }
+
+    return len;
+}
+
+/****************************************************************************
+ * a frame more on the ring, false if there is no room or nothing to do
+ ****************************************************************************/
+bool Si5351seq::fill(void) {
+    uint8_t frame[15], len;
+
+    if (gdone || (uint16_t)(size - used) < sizeof(frame)) return false;
+
+    len = compute(frame);
+    for (uint8_t i = 0; i < len; i++) {
+        ring[head] = frame[i];
+        if (++head == size) head = 0;
+    }
+    used += len;
+
+    return true;
+}
+
+uint8_t Si5351seq::pop(void) {
+    uint8_t v = ring[tail];
+
+    if (++tail == size) tail = 0;
+    used--;
+
+    return v;
+}
+
+// the next frame to the output, false if the sequence is over
+bool Si5351seq::advance(void) {
+    uint8_t h, i;
+
+    // no frames: the generator is done (or a ring too small, make one now)
+    if (!used && !fill()) {
+        prun = false;
+        return false;
+    }
+
+    h = pop();
+    for (i = 0; i < 6; i++) {
+        if (h & (1 << i)) pimg.pll[2 + i] = pop();
+    }
+    if (h & 0x80) {
+        for (i = 0; i < sizeof(pimg.ms); i++) pimg.ms[i] = pop();
+    }
+
+    if (++pstep == count) pstep = 0;
+
+    // the output lost its PLL to other one, stop here
+    if (!apply()) {
+        prun = false;
+        return false;
+    }
+
+    return true;
+}
+
+bool Si5351seq::apply(void) {
+    // applyRegs() resets if the output divider bank is not on the chip
+    bool ms = !si.cached(42 + clk * 8, pimg.ms, sizeof(pimg.ms));
+
+    // refused: the PLL is shared (an I2C error is not, the lib sends it
+    // again with the next write)
+    if (!si.applyRegs(clk, pimg) && !si.failed) return false;
+
+    // applyRegs() doesn't know the freq, we do: setFreq() & the live
+    // correction go on from it after the sequence
+    si.clkfreq[clk] = stepFreq(pstep);
+    preset = ms;
+
+    return true;
+}
+
+void Si5351seq::tick(void) {
+    if (due < 255) due++;
+}
+
+bool Si5351seq::poll(void) {
+    if (!prun) return false;
+
+    if (dwell) {
+        if ((int32_t)(micros() - pnext) < 0) {
+            fill();
+            return false;
+        }
+        pnext += dwell;
+    } else {
+        if (!due) {
+            fill();
+            return false;
+        }
+        noInterrupts();
+        due--;
+        interrupts();
+    }
+
+    return advance();
+}
+
+void Si5351seq::stop(void) {
+    prun = false;
+    gdone = true;
+}
+
+uint16_t Si5351seq::plannedResets(void) {
+    uint16_t n = 0, div = sdiv, d, i;
+    uint8_t R = sR, r;
+    uint32_t last = stepFreq(0), f;
+
+    for (i = 1; i <= count; i++) {
+        // the wrap to the first step, if it loops
+        if (i == count && !loop) break;
+
+        f = stepFreq(i % count);
+        r = R;
+        d = Si5351mcu::planDiv(div, r, last, f, false);
+        if (d != div || r != R) n++;
+        div = d;
+        R = r;
+        last = f;
+    }
+
+    return n;
 }
@@ -33,6 +33,9 @@
  * CLK1 will use PLLB
  * CLK2 will use PLLB
  *
+ * (That's the default, the PLL allocator will move them as needed so all
+ * the outputs can run at the same time, see setFreq() on the .cpp)
+ *
  * Lib defaults
  * - XTAL is 27 Mhz.
  * - Always put the internal 8pF across the xtal legs to GND
@@ -54,11 +57,22 @@
 #include "Arduino.h"
 #include "Wire.h"
 
-// default I2C address of the Si5351A - other variants may differ
+// default I2C address of the Si5351A - other variants may differ, you can
+// pass other one (and other I2C bus) on the constructor
 #define SIADDR 0x60
 
-// The number of output channels - 3 for Si5351A 10 pin
-#define SICHANNELS 3
+// The number of output channels - 3 for Si5351A 10 pin, up to 8 for the
+// bigger ones: the default for the constructor, the class has room for the
+// 8 of them (SI_CHANNELS_MAX) so the sketch and the lib build don't need
+// to agree on it
+#define SI_CHANNELS_MAX 8
+#ifndef SICHANNELS
+    #define SICHANNELS 3
+#endif
+
+#if SICHANNELS > 8
+    #error "SICHANNELS: the Si5351 has 8 outputs at most"
+#endif
 
 // register's power modifiers
 #define SIOUT_2mA 0
@@ -70,8 +84,217 @@
 #define SICLK0_R   76       // 0b01001100
 #define SICLK12_R 108       // 0b01101100
 
+// max VCO freq, see the OVERCLOCK section on the README
+#ifdef SI_OVERCLOCK
+    #define SI_VCO_MAX SI_OVERCLOCK
+#else
+    #define SI_VCO_MAX 900000000L
+#endif
+
+// min VCO freq, from the datasheet
+#define SI_VCO_MIN 600000000L
+
+// output freq range of the divider math: R up to 128 on the bottom (~7.8 kHz,
+// ~8.7 kHz with a 1 GHz VCO) and the output divider down to 4 on the top
+#define SI_FREQ_MIN (SI_VCO_MAX / 115328 + 1)
+#define SI_FREQ_MAX (SI_VCO_MAX / 4)
+
+// registers mirrored in the shadow: from the CLKx control ones (16) to the
+// last byte of the last multisynth bank; MS6 & MS7 are just a byte each (90,
+// 91) and the R6/R7 (92). A chip with less outputs uses just the first
+// 42 + 8 * channels - 16 bytes
+#define SI_SHADOW_FIRST 16
+#define SI_SHADOW_LAST  92
+#define SI_SHADOW_SIZE  (SI_SHADOW_LAST - SI_SHADOW_FIRST + 1)
+
+// max data bytes in a single I2C burst (the AVR Wire buffer is 32 bytes,
+// one is for the register address)
+#define SI_BURST_MAX 31
+
+// on a commit(), gaps of up to this known registers are sent again to merge
+// two bursts in one
+#define SI_BATCH_GAP 8
+
+// max data bytes in a single I2C read (the AVR Wire buffer)
+#define SI_READ_MAX 32
+
+// device status (reg 0) & sticky status (reg 1) bits, see status()
+#define SI_SYS_INIT     0x80
+#define SI_LOL_B        0x40
+#define SI_LOL_A        0x20
+#define SI_LOS_CLKIN    0x10
+#define SI_LOS_XTAL     0x08
+
+// I2C: retries of a failed transaction and the wait before the first one
+// (uS, doubled each time); they change the lib code, so like SI_STATS they
+// must be build flags (-DSI_I2C_RETRIES=0), a define before the include is
+// not enough
+#ifndef SI_I2C_RETRIES
+    #define SI_I2C_RETRIES 2
+#endif
+#ifndef SI_I2C_BACKOFF
+    #define SI_I2C_BACKOFF 50
+#endif
+
+// waitLocked() time between status reads (uS), to leave the bus to others
+#ifndef SI_LOCK_POLL
+    #define SI_LOCK_POLL 50
+#endif
+
+// a precomputed register image for a freq, see computeRegs() & SI5351_REGS()
+struct Si5351regs {
+    uint8_t pll[8];     // PLL bank (MSNA / MSNB)
+    uint8_t ms[8];      // output multisynth bank (MSx)
+};
+
+// hot path counters: define SI_STATS before the include (and for the lib
+// build too, as a build flag) to get them, see getStats(); SI_STATS_TIME
+// adds the time on the bus. They cost RAM, code and a bit of time per call
+#ifdef SI_STATS_TIME
+    #define SI_STATS
+#endif
+
+#ifdef SI_STATS
+struct Si5351stats {
+    uint32_t calls;         // setFreq() calls
+    uint32_t fast;          // of them, division free fast path
+    uint32_t full;          // of them, full math
+    uint32_t resets;        // PLL resets
+    uint32_t writes;        // write transactions
+    uint32_t reads;         // read transactions
+    uint32_t bytesWritten;  // data bytes written (register address included)
+    uint32_t bytesRead;     // data bytes read
+    uint32_t errors;        // I2C errors (NACK, short reads...), after the retries
+    uint32_t retries;       // I2C retries
+    uint32_t busMicros;     // uS waiting for the bus (SI_STATS_TIME only)
+};
+#endif
+
+// a PLL multiplier or output divider as in the registers:
+// (P1 + 512 + P2 / P3) / 128, see Si5351mcu::ratio()
+struct Si5351div {
+    uint32_t P1, P2, P3;
+};
+
+// an output decoded from the chip registers, see readState()
+struct Si5351clk {
+    uint8_t   ctrl;     // CLKx control register (PDN, INT, PLL, source, drive)
+    uint8_t   R;        // R divider (1 to 128)
+    Si5351div ms;       // output multisynth divider
+    uint64_t  freq;     // output freq in milli Hz, 0 if off or not from MSx
+};
+
+// the chip state decoded from its registers, see readState()
+struct Si5351state {
+    uint8_t   status;   // reg 0, device status
+    uint8_t   sticky;   // reg 1, sticky status bits
+    uint8_t   oeb;      // reg 3, output disable bits
+    Si5351div pll[2];   // PLLA & PLLB multipliers
+    uint64_t  vco[2];   // PLLA & PLLB freq in milli Hz
+    Si5351clk clk[SI_CHANNELS_MAX];
+};
+
+/****************************************************************************
+ * Compile time register images
+ *
+ * The same math of setFreq() as constexpr functions, so a table of register
+ * images can be computed by the compiler and placed in flash:
+ *
+ *   const Si5351regs tones[] PROGMEM = {
+ *       SI5351_REGS(27000000L, 14097000),
+ *       SI5351_REGS(27000000L, 14097002),
+ *       ...
+ *   };
+ *
+ *   Si.applyRegs_P(0, &tones[n]);
+ *
+ * The xtal must be the corrected one (base + correction) to get the same
+ * values as the runtime math. A freq out of SI_FREQ_MIN to SI_FREQ_MAX
+ * stops the build.
+ ****************************************************************************/
+template <bool ok> struct si_check {
+    static_assert(ok, "SI5351_REGS: freq out of SI_FREQ_MIN to SI_FREQ_MAX");
+};
+
+constexpr uint32_t si_rmul(uint32_t d, uint32_t r = 1) {
+    return d > 900 ? si_rmul(d / 2, r * 2) : r;
+}
+
+constexpr uint32_t si_odiv(uint32_t d) {
+    return d > 900 ? si_odiv(d / 2) : d & ~1UL;
+}
+
+constexpr uint8_t si_rbits(uint32_t r) {
+    return r > 1 ? 16 + si_rbits(r / 2) : 0;
+}
+
+constexpr uint32_t si_fvco(uint32_t f) {
+    return si_odiv(SI_VCO_MAX / f) * si_rmul(SI_VCO_MAX / f) * f;
+}
+
+constexpr uint32_t si_b(uint32_t x, uint32_t f) {
+    return (si_fvco(f) % x) >> 5;
+}
+
+constexpr uint32_t si_f(uint32_t x, uint32_t f) {
+    return (128 * si_b(x, f)) / (x >> 5);
+}
+
+constexpr uint32_t si_p1(uint32_t x, uint32_t f) {
+    return 128 * (si_fvco(f) / x) + si_f(x, f) - 512;
+}
+
+constexpr uint32_t si_p2(uint32_t x, uint32_t f) {
+    return 128 * si_b(x, f) - si_f(x, f) * (x >> 5);
+}
+
+constexpr uint8_t si_bank(uint32_t P1, uint32_t P2, uint32_t P3, uint8_t i) {
+    return i == 0 ? (P3 >> 8) & 0xFF :
+           i == 1 ? P3 & 0xFF :
+           i == 2 ? (P1 >> 16) & 0x03 :
+           i == 3 ? (P1 >> 8) & 0xFF :
+           i == 4 ? P1 & 0xFF :
+           i == 5 ? ((P3 >> 12) & 0xF0) | ((P2 >> 16) & 0x0F) :
+           i == 6 ? (P2 >> 8) & 0xFF : P2 & 0xFF;
+}
+
+constexpr uint8_t si_pllreg(uint32_t x, uint32_t f, uint8_t i) {
+    return si_bank(si_p1(x, f), si_p2(x, f), x >> 5, i);
+}
+
+constexpr uint8_t si_msreg(uint32_t f, uint8_t i) {
+    return i == 2 ? si_bank(128 * si_odiv(SI_VCO_MAX / f) - 512, 0, 1, 2) |
+                    si_rbits(si_rmul(SI_VCO_MAX / f)) |
+                    (si_odiv(SI_VCO_MAX / f) == 4 ? 0x0C : 0) :
+                    si_bank(128 * si_odiv(SI_VCO_MAX / f) - 512, 0, 1, i);
+}
+
+#define SI5351_REGS(xtal, freq) { \
+    { (uint8_t)(si_pllreg(xtal, freq, 0) + 0 * sizeof(si_check<((freq) >= SI_FREQ_MIN && \
+                                                             (freq) <= SI_FREQ_MAX)>)), \
+      si_pllreg(xtal, freq, 1), \
+      si_pllreg(xtal, freq, 2), si_pllreg(xtal, freq, 3), \
+      si_pllreg(xtal, freq, 4), si_pllreg(xtal, freq, 5), \
+      si_pllreg(xtal, freq, 6), si_pllreg(xtal, freq, 7) }, \
+    { si_msreg(freq, 0), si_msreg(freq, 1), si_msreg(freq, 2), si_msreg(freq, 3), \
+      si_msreg(freq, 4), si_msreg(freq, 5), si_msreg(freq, 6), si_msreg(freq, 7) } }
+
 class Si5351mcu {
+    // the sequencer plays precomputed frames on the lib state
+    friend class Si5351seq;
+
     private:
+        // the I2C bus & address of this chip, the outputs it has and the
+        // shadow bytes they use
+        TwoWire  *bus;
+        uint8_t   addr;
+        uint8_t   channels;
+        uint8_t   shadowSize;
+
+        // all the instances, for pumpAll()
+        Si5351mcu *next;
+        static Si5351mcu *chain;
+
         // base xtal freq, over this we apply the correction factor
         // by default 27 MHz
         uint32_t base_xtal = 27000000L;
@@ -81,7 +304,44 @@ class Si5351mcu {
         uint32_t int_xtal = base_xtal;
 
         // clk# power holders (2ma by default)
-        uint8_t clkpower[SICHANNELS] = { 0 };
+        uint8_t clkpower[SI_CHANNELS_MAX] = { 0 };
+
+        // PLL feeding each clk#, a bit per clk: 0 = PLLA, 1 = PLLB
+        // by default CLK0 use PLLA and the rest PLLB
+        uint8_t clkpll = 0xFE;
+
+        // PLL allocator: the clk that moves each PLL (0xFF none) and the
+        // VCO it's on (0 if not known), a bit per clk in use (set & not
+        // disabled) and a bit per clk with a fractional output divider
+        uint8_t   pllowner[2] = { 0xFF, 0xFF };
+        uint32_t  pllvco[2] = { 0 };
+        uint8_t   clkused = 0;
+        uint8_t   clkfrac = 0;
+
+        // reg 92 (R6 & R7) image
+        uint8_t   r92 = 0;
+
+        // quadrature pair (0xFF none) and the divider of the Q offset
+        uint8_t   quadI = 0xFF, quadQ = 0xFF;
+        uint8_t   quadN = 0;
+        void      quadOff(void);
+
+        // the output holding the idle PLL with a hop prepared (0xFF none)
+        // and the freq it will get on hop()
+        uint8_t   hopclk = 0xFF;
+        uint32_t  hopfreq = 0;
+        void      hopOff(void);
+
+        // the PLL allocator, see the .cpp
+        uint8_t following(uint8_t clk);
+        uint8_t alloc(uint8_t clk);
+        bool    follow(uint8_t clk, uint32_t freq);
+        uint8_t fracMath(uint8_t clk, uint32_t fvco, uint32_t freq, uint8_t *regs);
+
+        // output multisynth writes and the CLKx control value
+        void    msWrite(uint8_t clk, uint16_t outdivider, uint8_t R);
+        void    ms67(uint8_t clk, uint8_t outdivider, uint8_t R);
+        uint8_t clkCtrl(uint8_t clk);
 
         // local var to keep track of when to reset the "pll"
         /*********************************************************
@@ -101,66 +361,369 @@ class Si5351mcu {
          *
          * It's a word (16 bit) because the final max value is 900
          *********************************************************/
-        uint16_t  omsynth[SICHANNELS] = { 0 };
-        uint8_t   o_Rdiv[SICHANNELS] = { 0 };
+        uint16_t  omsynth[SI_CHANNELS_MAX] = { 0 };
+        uint8_t   o_Rdiv[SI_CHANNELS_MAX] = { 0 };
+
+        // setFreq() fast path data: last freq, remainder of fvco / xtal and
+        // the last PLL MSNx_P1 + 512 & MSNx_P2 values
+        uint32_t  o_freq[SI_CHANNELS_MAX] = { 0 };
+        int32_t   o_rem[SI_CHANNELS_MAX];
+        uint16_t  o_N[SI_CHANNELS_MAX];
+        int32_t   o_P2[SI_CHANNELS_MAX];
+
+        // the last freq set on each clk, to know the sweep direction
+        uint32_t  clkfreq[SI_CHANNELS_MAX] = { 0 };
+
+        // the output divider planner, keeps the divider if possible
+        uint16_t plan(uint8_t clk, uint32_t freq, uint8_t &R);
+        static uint16_t planDiv(uint16_t odiv, uint8_t &R, uint32_t last, uint32_t freq, bool ms67);
+
+        // the PLL resets: just one PLL (0/1) or the reg 177 bits, and the
+        // real one
+        void    resetPll(uint8_t pll);
+        void    resetBits(uint8_t bits);
+        uint8_t pllReset(uint8_t bits);
+
+        // init() & initWarm() helpers
+        void initState(uint32_t nxtal);
+        void sscOff(void);
+        bool warmState(void);
+
+        // division free fast path for setFreq()
+        bool fastPll(uint8_t clk, uint32_t freq, uint32_t &P1, uint32_t &P2);
+
+        // setFreq() & setFreqMilli()
+        bool tune(uint8_t clk, uint32_t freq, uint16_t milli, bool fine);
+
+        // high precision mode: milli Hz of each clk and a bit per clk on it
+        uint16_t  clkmilli[SI_CHANNELS_MAX] = { 0 };
+        uint8_t   clkfine = 0;
+
+        // the PLL math & registers bank
+        uint32_t pllMath(uint32_t fvco, uint32_t &P1, uint32_t &P2);
+        static void pllFine(uint32_t xtal, uint32_t fvco, uint32_t extra, uint32_t &P1, uint32_t &P2, uint32_t &P3);
+
+        // pllFine(), hooked by setFreqMilli(): tune() calls it through this
+        // so a sketch that doesn't use the high precision mode doesn't link
+        // it (64 bit math, big on 8 bit MCUs)
+        void (*fineMath)(uint32_t, uint32_t, uint32_t, uint32_t &, uint32_t &, uint32_t &) = NULL;
+        static void pllBank(uint8_t *regs, uint32_t P1, uint32_t P2, uint32_t P3);
+
+        // output divider & R selection, and the output multisynth bank
+        static uint16_t divider(uint32_t freq, uint8_t &R);
+        static void msBank(uint8_t *regs, uint16_t outdivider, uint8_t R);
+
+        // true if the chip already has this data (from the shadow)
+        bool cached( const uint8_t start_register, const uint8_t *data, const uint8_t numbytes );
+
+        // shadow of what was last written to the chip, and a bit per
+        // register to know if the shadow value is valid (it's not after init)
+        uint8_t   shadow[SI_SHADOW_SIZE];
+        uint8_t   shadow_ok[(SI_SHADOW_SIZE + 7) / 8] = { 0 };
+
+        // pending registers to send on a commit(), and the transaction state
+        uint8_t   shadow_dirty[(SI_SHADOW_SIZE + 7) / 8] = { 0 };
+        bool      batch = false;
+        uint8_t   reset_pending = 0;     // reg 177 bits: 0x20 PLLA, 0x80 PLLB
+
+        // async mode: writes are left pending for pump()
+        bool      queued = false;
+
+        // the commit() helpers
+        bool      nextSpan(uint8_t &first, uint8_t &len);
+        uint8_t   sendSpan(uint8_t first, uint8_t len);
+        uint8_t   flush(void);
+
+        // I2C errors: a write failed and the chip is not in sync yet, and a
+        // write failed during the actual call
+        bool      dirty = false;
+        bool      failed = false;
+        void      fault(void);
+        void      lost(void);
+        uint8_t   replay(void);
+
+#ifdef SI_STATS
+        Si5351stats stats = {};
+#endif
+
+        // raw burst write to the chip, no shadow
+        uint8_t i2cSend( const uint8_t start_register, const uint8_t *data, const uint8_t numbytes );
+
+        // floor(a * b / c) with no overflow, for the state decoder
+        static uint64_t mulDiv(uint64_t a, uint32_t b, uint64_t c);
+        static void     unBank(const uint8_t *regs, Si5351div &d);
 
     public:
         // var to check the clock state
-        bool clkOn[SICHANNELS] = { 0 };     // This should not really be public - use isEnabled()
+        bool clkOn[SI_CHANNELS_MAX] = { 0 };     // This should not really be public - use isEnabled()
 
     public:
+        // the I2C bus & address of the chip and its outputs (up to 8), by
+        // default Wire, SIADDR & SICHANNELS
+        Si5351mcu(TwoWire &nbus = Wire, uint8_t naddr = SIADDR,
+                  uint8_t nchannels = SICHANNELS);
+        ~Si5351mcu(void);
+
         // default init procedure
         void init(void);
 
         // custom init procedure (XTAL in Hz);
         void init(uint32_t);
 
+        // warm start (default or custom XTAL): if the chip is already
+        // programmed keep it running and take our state from it, a plain
+        // init() if not; true if it was a warm start
+        bool initWarm(void);
+        bool initWarm(uint32_t);
+
         // reset all PLLs
-        static void reset(void);
+        void reset(void);
+
+        // set CLKx to freq (Hz), false if it can't be done with the other
+        // outputs in use (see the PLL allocator on the .cpp) or on I2C error
+        bool setFreq(uint8_t, uint32_t);
 
-        // set CLKx(0..2) to freq (Hz)
-        void setFreq(uint8_t, uint32_t);
+        // high precision mode: set CLKx to freq in milli Hz (sub Hz steps),
+        // slower; see the .cpp
+        bool setFreqMilli(uint8_t, uint64_t);
+
+        // quadrature (I/Q) LO: clkI & clkQ on freq with Q 90 degrees behind,
+        // resets only when the divider changes; from ~4.8 MHz up. Call it
+        // again or setFreq(clkI) to retune; see the .cpp
+        bool quadrature(uint8_t clkI, uint8_t clkQ, uint32_t freq);
 
         // pass a correction factor
         void correction(int32_t);
 
-        // enable some CLKx output
-        void enable(uint8_t);
+        // click free correction: Hz or ppb, the enabled outputs are set
+        // again to the last freq writing just the PLL registers, no reset
+        void correctionLive(int32_t);
+        void correctionPpb(int32_t);
+
+        // enable some CLKx output, false on I2C error (see isDirty()) or if
+        // it can't have its freq back after a disable() (the PLL is taken)
+        bool enable(uint8_t);
 
-        // disable some CLKx output
-        void disable(uint8_t);
+        // disable some CLKx output, false on I2C error
+        bool disable(uint8_t);
 
-        // disable all outputs
-        void off(void);
+        // disable all outputs, false on I2C error
+        bool off(void);
 
-        // set power output to a specific clk
-        void setPower(uint8_t, uint8_t);
+        // set power output to a specific clk, false on I2C error
+        bool setPower(uint8_t, uint8_t);
+
+        // frequency hopping on CLKx: program the next freq (Hz) on the idle
+        // PLL, returns false if it can't be done with the actual output divider
+        bool hopPrepare(uint8_t, uint32_t);
+
+        // switch CLKx to the PLL prepared by hopPrepare(), false if nothing
+        // is prepared for it
+        bool hop(uint8_t);
+
+        // compute the register image for a freq (Hz) with the actual xtal,
+        // false (and nothing touched) if out of SI_FREQ_MIN to SI_FREQ_MAX
+        bool computeRegs(uint32_t, Si5351regs &);
+
+        // start a transaction: writes are collected until the commit()
+        void begin(void);
+
+        // send all the collected writes in the fewest bursts & one reset at
+        // most, returns non zero on I2C error
+        uint8_t commit(void);
+
+        // async mode: setFreq() & friends don't wait for the bus, the
+        // writes are sent by pump() (the last value of a register wins)
+        void setAsync(bool);
+
+        // send the next pending burst, true if there is more to send (false
+        // on I2C error, it's sent again on the next one)
+        bool pump(void);
+
+        // true if there are writes waiting for a pump()
+        bool pending(void);
+
+        // pump() all the chips (instances) once, in turns: a retune of
+        // several chips sharing the bus is done in one pass. True if there
+        // is more to send
+        static bool pumpAll(void);
+
+        // send the full register image again (after a chip brown-out, or
+        // to recover from an I2C error now), false on I2C error
+        bool resync(void);
+
+        // apply a register image to CLKx, from RAM or flash (PROGMEM); false
+        // if CLKx can't have a PLL on its own (see the PLL allocator on the
+        // .cpp) or on I2C error
+        bool applyRegs(uint8_t, const Si5351regs &);
+        bool applyRegs_P(uint8_t, const Si5351regs *);
 
         // used to talk with the chip, via Arduino Wire lib
         //
-        // declared as static, since they do not reference any this-> class attributes
+        // writes are filtered by the shadow registers: only the bytes that
+        // changed are sent, and nothing at all if nothing changed
         //
-        static void     i2cWrite( const uint8_t reg, const uint8_t val );
-        static uint8_t  i2cWriteBurst( const uint8_t start_register, const uint8_t *data, const uint8_t numbytes );
-        static int16_t  i2cRead( const uint8_t reg );
+        uint8_t         i2cWrite( const uint8_t reg, const uint8_t val );
+        uint8_t         i2cWriteBurst( const uint8_t start_register, const uint8_t *data, const uint8_t numbytes );
+        int16_t         i2cRead( const uint8_t reg );
+
+        // burst read of count registers, in as few transactions as the Wire
+        // buffer allows; returns the count of bytes read (count if all ok)
+        uint8_t         i2cReadBurst( const uint8_t start_register, uint8_t *data, const uint8_t count );
+
+        // device status (reg 0) & sticky status (reg 1), see the SI_LOL_A
+        // & friends bits; -1 on I2C error. sticky(true) clears it after
+        // the read
+        int16_t status(void);
+        int16_t sticky(bool clear = false);
+
+        // wait for the PLLs in use to lock (after a reset, a retune...):
+        // returns the time it took (uS) or -1 after timeout uS
+        int32_t waitLocked(uint32_t timeout);
+
+        // read the chip state (PLLs, multisynths, CLKx control) in a few
+        // bursts and decode it with integer math, false on I2C error
+        bool readState(Si5351state &);
+
+        // a divider/multiplier times scale (rounded down), integer math:
+        // ratio(pll, 1000000) is the multiplier with 6 decimals
+        static uint64_t ratio(const Si5351div &, uint32_t scale);
         
-        inline const bool isEnabled( const uint8_t channel ) {
-          return channel < SICHANNELS && clkOn[ channel ] != 0;
+        inline bool isEnabled( const uint8_t channel ) {
+          return channel < channels && clkOn[ channel ] != 0;
         };
         
-        inline const uint8_t getPower( const uint8_t channel ) {
-          return channel < SICHANNELS ? clkpower[ channel ] : 0;  
+        inline uint8_t getPower( const uint8_t channel ) {
+          return channel < channels ? clkpower[ channel ] : 0;  
+        };
+
+        inline uint8_t getChannels( void ) {
+          return channels;
         };
 
-        inline const uint32_t getXtalBase( void ) {
+        inline uint32_t getXtalBase( void ) {
           return base_xtal;
         };
 
-        inline const uint32_t getXtalCurrent( void ) {
+        inline uint32_t getXtalCurrent( void ) {
           return int_xtal;
         };
+
+        // a write failed and the chip is not in sync yet, the next write
+        // (or commit(), pump(), resync()) sends all again
+        inline bool isDirty( void ) {
+          return dirty;
+        };
+
+#ifdef SI_STATS
+        // the hot path counters, see SI_STATS
+        inline const Si5351stats &getStats( void ) {
+          return stats;
+        };
+
+        inline void resetStats( void ) {
+          memset(&stats, 0, sizeof(stats));
+        };
+#endif
         
 };
 
 
+/****************************************************************************
+ * Sweep/hop sequencer: the steps of a sweep or a list of freqs for an output
+ * are computed ahead into a ring of compact frames (the PLL bytes that
+ * change & the output divider when it changes) and played with just the
+ * I2C bytes, on a fixed dwell or on a timer tick. See the .cpp.
+ *
+ *   uint8_t ring[64];
+ *   Si5351seq seq(Si, ring, sizeof(ring));
+ *
+ *   seq.sweep(0, 1000000, 30000000, 10000, 1000);    // 1 mS per step
+ *   while (seq.running()) {
+ *       if (seq.poll()) { ... seq.freq() is on the output now ... }
+ *   }
+ ****************************************************************************/
+class Si5351seq {
+    private:
+        Si5351mcu &si;
+
+        // the ring of frames, generator (head) & player (tail) sides
+        uint8_t  *ring;
+        uint16_t  size, head = 0, tail = 0, used = 0;
+
+        // the sequence: a sweep (start, step) or a list, count steps
+        uint8_t   clk = 0;
+        uint32_t  start = 0;
+        int32_t   step = 0;
+        const uint32_t *flist = 0;
+        uint16_t  count = 0;
+        uint32_t  dwell = 0;
+        bool      loop = false;
+
+        // generator: next step to compute, the output divider, R & freq of
+        // the last one and its image; the divider & R of the first step
+        uint16_t  gstep = 0;
+        bool      gdone = true;
+        uint16_t  gdiv = 0;
+        uint8_t   gR = 0;
+        uint32_t  glast = 0;
+        Si5351regs gimg;
+        uint16_t  sdiv = 0;
+        uint8_t   sR = 0;
+
+        // player: step on the output, the image the chip has and the time
+        // of the next step (or the ticks due)
+        uint16_t  pstep = 0;
+        bool      prun = false;
+        bool      preset = false;
+        Si5351regs pimg;
+        uint32_t  pnext = 0;
+        volatile uint8_t due = 0;
+
+        uint32_t stepFreq(uint16_t i);
+        uint8_t  compute(uint8_t *frame);
+        bool     fill(void);
+        uint8_t  pop(void);
+        bool     advance(void);
+        bool     apply(void);
+        bool     prepare(uint8_t nclk, uint32_t ndwell, bool nloop);
+
+    public:
+        // the chip & the ring buffer (a frame is 2 to 15 bytes, 16 minimum)
+        Si5351seq(Si5351mcu &nsi, uint8_t *nring, uint16_t nsize);
+
+        // a sweep from start to stop (Hz, up or down) by step (Hz) or a list
+        // of freqs (RAM) on clk (0 to 5), dwell uS per step or 0 to step on
+        // each tick(); loop to start over at the end. The first step is set
+        // at once; false if it can't be done (a step out of SI_FREQ_MIN to
+        // SI_FREQ_MAX too), the old sequence is stopped anyway
+        bool sweep(uint8_t clk, uint32_t start, uint32_t stop, uint32_t step,
+                   uint32_t dwell, bool loop = false);
+        bool list(uint8_t clk, const uint32_t *freqs, uint16_t count,
+                  uint32_t dwell, bool loop = false);
+
+        // from a timer ISR (dwell 0): a step is due, poll() will make it
+        void tick(void);
+
+        // from the main loop: make the next step if it's due and compute the
+        // next frames; true if a step was just made. It stops if the output
+        // lost its PLL (other output set on it)
+        bool poll(void);
+
+        // stop the playback, the output keeps the last step
+        void stop(void);
+
+        // playing? the step on the output, its freq & if it was a reset
+        bool     running(void) { return prun; };
+        uint16_t index(void) { return pstep; };
+        uint32_t freq(void) { return stepFreq(pstep); };
+        bool     wasReset(void) { return preset; };
+
+        // PLL resets (output divider changes) in a pass of the sequence, the
+        // same rule setFreq() uses; the wrap to the first step included if
+        // it loops
+        uint16_t plannedResets(void);
+};
+
+
 #endif //SI5351MCU_H